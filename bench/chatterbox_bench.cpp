@@ -0,0 +1,151 @@
+// Compares end-to-end synthesis speed of ChatterBox session presets.
+//
+// Usage: chatterbox_bench <ModelDir> <StyleDir> <config.json>... [--runs N] [--text "..."]
+//
+// "allocs/step" is the median number of operator new calls per decode step
+// after the prefill, counted by the replacement operators below. It includes
+// the allocations made inside ONNX Runtime.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+#include "chatterbox.h"
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <ModelDir> <StyleDir> <config.json>... [--runs N] [--text \"...\"]" << std::endl;
+        return 1;
+    }
+
+    std::string modelDir = argv[1];
+    std::string styleDir = argv[2];
+    std::vector<std::string> configPaths;
+    int runs = 3;
+    std::string text = "Hello, welcome to my world! This sentence is used to compare session presets.";
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--text" && i + 1 < argc) {
+            text = argv[++i];
+        } else {
+            configPaths.push_back(arg);
+        }
+    }
+
+    BPETokenizer tokenizer;
+    if (!tokenizer.loadFromFile("assets/tokenizer.json")) {
+        std::cerr << "Failed to load tokenizer!" << std::endl;
+        return 1;
+    }
+    std::vector<int64_t> inputIds = tokenizer.encode(text, true);
+
+    std::printf("%-32s %10s %10s %10s %10s %8s %12s %9s %9s %7s\n", "preset", "load ms", "tokens ms", "vocoder ms",
+                "audio s", "RTF", "allocs/step", "arena MB", "held MB", "reuse");
+    for (const auto& configPath : configPaths) {
+        ChatterBoxConfig config;
+        if (!config.loadFromFile(configPath)) {
+            return 1;
+        }
+
+        auto loadStart = Clock::now();
+        ChatterBox chatterbox(modelDir, config);
+        chatterbox.LoadStyle(styleDir);
+        double loadMs = elapsedMs(loadStart);
+
+        // Warm-up run, not measured
+        chatterbox.synthesizeSpeech(chatterbox.SynthesizeSpeechTokens(inputIds));
+
+        double tokensMs = 0.0;
+        double vocoderMs = 0.0;
+        double audioSeconds = 0.0;
+        std::vector<uint64_t> stepAllocations;
+        std::vector<uint64_t> counts;
+        counts.reserve(1100);
+        for (int run = 0; run < runs; run++) {
+            // The callback runs once per generated token; consecutive counts
+            // bracket one decode step
+            counts.clear();
+            auto countStep = [&counts](const std::vector<int64_t>&, bool) {
+                if (counts.size() < counts.capacity()) {
+                    counts.push_back(allocationCount.load(std::memory_order_relaxed));
+                }
+                return true;
+            };
+            auto start = Clock::now();
+            std::vector<int64_t> generatedTokens = chatterbox.SynthesizeSpeechTokens(inputIds, countStep);
+            tokensMs += elapsedMs(start);
+            for (size_t i = 1; i + 1 < counts.size(); i++) {
+                stepAllocations.push_back(counts[i] - counts[i - 1]);
+            }
+
+            start = Clock::now();
+            std::vector<int16_t> audio = chatterbox.synthesizeSpeech(generatedTokens);
+            vocoderMs += elapsedMs(start);
+            audioSeconds += audio.size() / 24000.0;
+        }
+
+        uint64_t medianAllocations = 0;
+        if (!stepAllocations.empty()) {
+            auto middle = stepAllocations.begin() + stepAllocations.size() / 2;
+            std::nth_element(stepAllocations.begin(), middle, stepAllocations.end());
+            medianAllocations = *middle;
+        }
+
+        // Peak use and held capacity of both arenas, and the share of blocks placed
+        // in memory used before; zero for presets without request_arena
+        RequestArena::Stats languageModelArena = chatterbox.languageModelArenaStats();
+        RequestArena::Stats vocoderArena = chatterbox.vocoderArenaStats();
+        size_t arenaPeak = languageModelArena.peak + vocoderArena.peak;
+        size_t arenaCapacity = languageModelArena.capacity + vocoderArena.capacity;
+        uint64_t arenaAllocations = languageModelArena.allocations + vocoderArena.allocations;
+        uint64_t arenaReused = languageModelArena.reused + vocoderArena.reused;
+        double reuse = arenaAllocations > 0 ? 100.0 * arenaReused / arenaAllocations : 0.0;
+
+        std::printf("%-32s %10.1f %10.1f %10.1f %10.2f %8.3f %12llu %9.1f %9.1f %6.1f%%\n", configPath.c_str(), loadMs,
+                    tokensMs / runs, vocoderMs / runs, audioSeconds / runs,
+                    (tokensMs + vocoderMs) / 1000.0 / audioSeconds,
+                    static_cast<unsigned long long>(medianAllocations),
+                    arenaPeak / (1024.0 * 1024.0), arenaCapacity / (1024.0 * 1024.0), reuse);
+    }
+    return 0;
+}
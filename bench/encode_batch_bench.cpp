@@ -0,0 +1,119 @@
+// Measures BPETokenizer::encodeBatch throughput as the thread count grows.
+//
+// Usage: encode_batch_bench <tokenizer.json|tokenizer.bin> <corpus.txt> [--max-threads N] [--runs N]
+//
+// Each line of the corpus is one text. For every thread count the word cache is
+// cleared, then one cold pass and the best of --runs warm passes are timed.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <tokenizer.json|tokenizer.bin> <corpus.txt> [--max-threads N] [--runs N]" << std::endl;
+        return 1;
+    }
+
+    std::string tokenizerPath = argv[1];
+    std::string corpusPath = argv[2];
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int runs = 3;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--max-threads" && i + 1 < argc) {
+            maxThreads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::stoi(argv[++i]));
+        }
+    }
+
+    BPETokenizer tokenizer;
+    bool loaded = endsWith(tokenizerPath, ".json") ? tokenizer.loadFromFile(tokenizerPath)
+                                                   : tokenizer.loadCompiled(tokenizerPath);
+    if (!loaded) {
+        return 1;
+    }
+
+    std::ifstream corpus(corpusPath);
+    if (!corpus.is_open()) {
+        std::cerr << "Error: Cannot open corpus: " << corpusPath << std::endl;
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(corpus, line)) {
+        lines.push_back(line);
+    }
+    std::printf("%zu lines\n", lines.size());
+
+    // Thread counts 1, 2, 4, ... up to maxThreads
+    std::vector<size_t> threadCounts;
+    for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::printf("%8s %14s %14s %10s %10s\n", "threads", "cold lines/s", "warm lines/s", "speedup", "hit rate");
+    double baseline = 0.0;
+    EncodedBatch reference;
+    for (size_t threads : threadCounts) {
+        tokenizer.setThreadCount(threads);
+        tokenizer.setCacheCapacity(BPEWordCache::DEFAULT_CAPACITY);
+        BPEWordCache::Stats before = tokenizer.cacheStats();
+
+        auto coldStart = Clock::now();
+        EncodedBatch batch = tokenizer.encodeBatch(lines);
+        double coldSeconds = elapsedSeconds(coldStart);
+
+        double warmSeconds = 0.0;
+        for (int run = 0; run < runs; run++) {
+            auto warmStart = Clock::now();
+            batch = tokenizer.encodeBatch(lines);
+            double seconds = elapsedSeconds(warmStart);
+            warmSeconds = run == 0 ? seconds : std::min(warmSeconds, seconds);
+        }
+
+        if (threads == 1) {
+            reference = batch;
+        } else if (batch.ids != reference.ids || batch.offsets != reference.offsets) {
+            std::cerr << "Error: results with " << threads << " threads differ from 1 thread" << std::endl;
+            return 1;
+        }
+
+        BPEWordCache::Stats after = tokenizer.cacheStats();
+        uint64_t hits = after.hits - before.hits;
+        uint64_t lookups = hits + after.misses - before.misses;
+        double hitRate = lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+
+        double coldRate = lines.size() / coldSeconds;
+        double warmRate = lines.size() / warmSeconds;
+        if (threads == 1) {
+            baseline = warmRate;
+        }
+        std::printf("%8zu %14.0f %14.0f %9.2fx %9.1f%%\n", threads, coldRate, warmRate,
+                    warmRate / baseline, 100.0 * hitRate);
+    }
+    return 0;
+}
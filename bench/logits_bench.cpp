@@ -0,0 +1,161 @@
+// Compares the logits kernels with the scalar code they replaced: argmax over
+// one step of logits, and the repetition penalty plus greedy selection over a
+// whole utterance.
+//
+// Usage: logits_bench [--vocab N] [--steps N] [--runs N]
+//
+// The reference implementations below are the previous ChatterBox code: a
+// scalar argmax loop, and a penalty that rebuilds an unordered_set from every
+// generated token at each step.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "logits_processor.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int64_t scalarArgmax(const float* logits, int64_t vocabSize) {
+    int64_t bestTokenId = 0;
+    float maxScore = -std::numeric_limits<float>::infinity();
+    for (int64_t v = 0; v < vocabSize; v++) {
+        if (logits[v] > maxScore) {
+            maxScore = logits[v];
+            bestTokenId = v;
+        }
+    }
+    return bestTokenId;
+}
+
+void scalarRepetitionPenalty(float* logits, const std::vector<int64_t>& generatedTokens, float penalty) {
+    std::unordered_set<int64_t> seenTokens;
+    for (auto id : generatedTokens) {
+        seenTokens.insert(id);
+    }
+    for (int64_t id : seenTokens) {
+        float& score = logits[id];
+        if (score < 0) {
+            score *= penalty;
+        } else {
+            score /= penalty;
+        }
+    }
+}
+
+// Best of runs, in seconds
+template <typename F>
+double best(int runs, F&& body) {
+    double fastest = 0.0;
+    for (int run = 0; run < runs; run++) {
+        auto start = Clock::now();
+        body();
+        double seconds = elapsedSeconds(start);
+        fastest = run == 0 ? seconds : std::min(fastest, seconds);
+    }
+    return fastest;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int64_t vocabSize = 6563;
+    int steps = 1000;
+    int runs = 5;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--vocab" && i + 1 < argc) {
+            vocabSize = std::max<int64_t>(1, std::stoll(argv[++i]));
+        } else if (arg == "--steps" && i + 1 < argc) {
+            steps = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::stoi(argv[++i]));
+        }
+    }
+    const float penalty = 1.2f;
+
+    // A pool of logit vectors, reused cyclically by the simulated decode steps
+    const int poolSize = 64;
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> normal(0.0f, 3.0f);
+    std::vector<std::vector<float>> pool(poolSize, std::vector<float>(vocabSize));
+    for (auto& step : pool) {
+        for (float& value : step) value = normal(rng);
+    }
+
+    std::printf("vocab %lld, %d steps, kernels: %s\n\n", static_cast<long long>(vocabSize), steps,
+                logits::kernelName());
+
+    // Argmax alone
+    int64_t checksum = 0;
+    const int argmaxCalls = 20000;
+    double scalarArgmaxSeconds = best(runs, [&]() {
+        for (int i = 0; i < argmaxCalls; i++) checksum += scalarArgmax(pool[i % poolSize].data(), vocabSize);
+    });
+    double simdArgmaxSeconds = best(runs, [&]() {
+        for (int i = 0; i < argmaxCalls; i++) checksum -= logits::argmax(pool[i % poolSize].data(), vocabSize);
+    });
+    for (const auto& step : pool) {
+        if (scalarArgmax(step.data(), vocabSize) != logits::argmax(step.data(), vocabSize)) {
+            std::cerr << "Error: argmax results differ" << std::endl;
+            return 1;
+        }
+    }
+
+    // Penalty + greedy selection over an utterance; the logits are copied to a
+    // work buffer first in both versions, as the penalty modifies them
+    std::vector<float> work(vocabSize);
+    std::vector<int64_t> scalarTokens;
+    double scalarStepSeconds = best(runs, [&]() {
+        std::vector<int64_t> generatedTokens{0};
+        for (int i = 0; i < steps; i++) {
+            const auto& step = pool[i % poolSize];
+            std::copy(step.begin(), step.end(), work.begin());
+            scalarRepetitionPenalty(work.data(), generatedTokens, penalty);
+            generatedTokens.push_back(scalarArgmax(work.data(), vocabSize));
+        }
+        scalarTokens = generatedTokens;
+    });
+
+    std::vector<int64_t> processorTokens;
+    LogitsProcessor processor(penalty, vocabSize);
+    double processorStepSeconds = best(runs, [&]() {
+        std::vector<int64_t> generatedTokens{0};
+        processor.reset();
+        processor.observe(0);
+        for (int i = 0; i < steps; i++) {
+            const auto& step = pool[i % poolSize];
+            std::copy(step.begin(), step.end(), work.begin());
+            processor.apply(work.data(), vocabSize);
+            int64_t tokenId = logits::argmax(work.data(), vocabSize);
+            processor.observe(tokenId);
+            generatedTokens.push_back(tokenId);
+        }
+        processorTokens = generatedTokens;
+    });
+    if (scalarTokens != processorTokens) {
+        std::cerr << "Error: generated tokens differ" << std::endl;
+        return 1;
+    }
+
+    std::printf("%-28s %12s %12s %9s\n", "", "scalar us", "new us", "speedup");
+    std::printf("%-28s %12.3f %12.3f %8.2fx\n", "argmax per call",
+                1e6 * scalarArgmaxSeconds / argmaxCalls, 1e6 * simdArgmaxSeconds / argmaxCalls,
+                scalarArgmaxSeconds / simdArgmaxSeconds);
+    std::printf("%-28s %12.3f %12.3f %8.2fx\n", "penalty + argmax per step",
+                1e6 * scalarStepSeconds / steps, 1e6 * processorStepSeconds / steps,
+                scalarStepSeconds / processorStepSeconds);
+    std::printf("%-28s %12.1f %12.1f\n", "per utterance",
+                1e6 * scalarStepSeconds, 1e6 * processorStepSeconds);
+    return checksum == 1 ? 1 : 0;
+}
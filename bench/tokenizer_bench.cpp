@@ -0,0 +1,287 @@
+// Measures tokenizer load time, encode/decode throughput and word cache hit
+// rates over a corpus of representative inputs.
+//
+// Usage: tokenizer_bench <tokenizer.json> <corpus_dir> [--json out.json]
+//                        [--baseline baseline.json] [--tolerance 0.1] [--min-time 0.2]
+//
+// corpus_dir holds one file per category (see CATEGORIES), one text per line;
+// bench/corpus is the default corpus. Every measurement repeats passes over a
+// category until --min-time seconds have been timed and reports the fastest
+// pass. Cold encoding clears the word cache before each pass, warm encoding
+// keeps it.
+//
+// --json writes the results. --baseline compares them with an earlier --json
+// file: the exit code is 2 if a throughput dropped or a load time grew by more
+// than --tolerance (a fraction of the baseline value).
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "bpe_tokenizer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using json = nlohmann::json;
+
+const char* const CATEGORIES[] = {
+    "short_prompts",
+    "long_paragraphs",
+    "special_tokens",
+    "non_ascii",
+};
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Run pass until at least minSeconds have been timed and return the fastest
+// pass; pass returns the seconds it timed, so it can leave setup work out
+double bestPass(double minSeconds, const std::function<double()>& pass) {
+    double total = 0.0;
+    double best = 0.0;
+    for (size_t passes = 0; passes == 0 || total < minSeconds; passes++) {
+        double seconds = pass();
+        total += seconds;
+        best = passes == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+json throughput(double seconds, size_t bytes, size_t tokens) {
+    return {
+        {"mb_per_s", bytes / seconds / 1e6},
+        {"tokens_per_s", tokens / seconds},
+    };
+}
+
+double hitRate(const BPEWordCache::Stats& before, const BPEWordCache::Stats& after) {
+    uint64_t hits = after.hits - before.hits;
+    uint64_t lookups = hits + after.misses - before.misses;
+    return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+}
+
+// Best of several runs of load, in milliseconds; -1 if it fails
+double loadMs(int runs, const std::function<bool(BPETokenizer&)>& load) {
+    double best = -1.0;
+    for (int run = 0; run < runs; run++) {
+        BPETokenizer tokenizer;
+        std::streambuf* out = std::cout.rdbuf(nullptr);
+        auto start = Clock::now();
+        bool loaded = load(tokenizer);
+        double ms = elapsedSeconds(start) * 1000.0;
+        std::cout.rdbuf(out);
+        if (!loaded) {
+            return -1.0;
+        }
+        best = best < 0.0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+// Compare every metric in baseline with result; throughputs (mb_per_s) must
+// not drop and times (keys ending in _ms) must not grow by more than tolerance.
+// tokens_per_s is left out, it moves with mb_per_s.
+int countRegressions(const json& baseline, const json& result, double tolerance,
+                     const std::string& path) {
+    int regressions = 0;
+    for (auto it = baseline.begin(); it != baseline.end(); ++it) {
+        const std::string& key = it.key();
+        std::string name = path.empty() ? key : path + "." + key;
+        if (!result.contains(key)) {
+            continue;
+        }
+        const json& value = result[key];
+        if (it->is_object()) {
+            regressions += countRegressions(*it, value, tolerance, name);
+            continue;
+        }
+        if (!it->is_number() || !value.is_number()) {
+            continue;
+        }
+
+        double expected = it->get<double>();
+        double actual = value.get<double>();
+        bool higherIsBetter = key == "mb_per_s";
+        bool lowerIsBetter = key.size() > 3 && key.compare(key.size() - 3, 3, "_ms") == 0;
+        bool regressed = (higherIsBetter && actual < expected * (1.0 - tolerance)) ||
+                         (lowerIsBetter && expected > 0.0 && actual > expected * (1.0 + tolerance));
+        if (regressed) {
+            std::printf("REGRESSION %-44s %10.3f -> %10.3f (%+.1f%%)\n", name.c_str(),
+                        expected, actual, 100.0 * (actual - expected) / expected);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <tokenizer.json> <corpus_dir> [--json out.json] [--baseline baseline.json]"
+                     " [--tolerance 0.1] [--min-time 0.2]" << std::endl;
+        return 1;
+    }
+
+    std::string tokenizerPath = argv[1];
+    std::filesystem::path corpusDir = argv[2];
+    std::string jsonPath;
+    std::string baselinePath;
+    double tolerance = 0.1;
+    double minTime = 0.2;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minTime = std::stod(argv[++i]);
+        }
+    }
+
+    json result;
+    result["tokenizer"] = tokenizerPath;
+
+    // Load times, JSON and compiled
+    std::string compiledPath = (std::filesystem::temp_directory_path() / "tokenizer_bench.bin").string();
+    BPETokenizer tokenizer;
+    if (!tokenizer.loadFromFile(tokenizerPath) || !tokenizer.saveCompiled(compiledPath)) {
+        return 1;
+    }
+    double jsonMs = loadMs(3, [&](BPETokenizer& t) { return t.loadFromFile(tokenizerPath); });
+    double compiledMs = loadMs(20, [&](BPETokenizer& t) { return t.loadCompiled(compiledPath); });
+    std::filesystem::remove(compiledPath);
+    result["load"] = {{"json_ms", jsonMs}, {"compiled_ms", compiledMs}};
+    std::printf("load: tokenizer.json %.2f ms, compiled %.3f ms\n\n", jsonMs, compiledMs);
+
+    std::printf("%-16s %8s %8s | %10s %12s %6s | %10s %12s %6s | %10s %12s\n",
+                "category", "bytes", "tokens",
+                "cold MB/s", "cold tok/s", "hit",
+                "warm MB/s", "warm tok/s", "hit",
+                "dec MB/s", "dec tok/s");
+
+    size_t sink = 0;
+    for (const char* category : CATEGORIES) {
+        std::filesystem::path corpusPath = corpusDir / (std::string(category) + ".txt");
+        std::ifstream corpus(corpusPath);
+        if (!corpus.is_open()) {
+            std::cerr << "Error: Cannot open corpus: " << corpusPath.string() << std::endl;
+            return 1;
+        }
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(corpus, line)) {
+            lines.push_back(line);
+        }
+
+        // Reference encoding; every text must survive a round trip
+        std::vector<std::vector<int64_t>> encoded;
+        size_t bytes = 0;
+        size_t tokens = 0;
+        for (const auto& text : lines) {
+            encoded.push_back(tokenizer.encode(text, false));
+            bytes += text.size();
+            tokens += encoded.back().size();
+            if (tokenizer.decode(encoded.back()) != text) {
+                std::cerr << "Error: Round trip changed: " << text << std::endl;
+                return 1;
+            }
+        }
+
+        auto encodePass = [&]() {
+            auto start = Clock::now();
+            for (const auto& text : lines) {
+                sink += tokenizer.encode(text, false).size();
+            }
+            return elapsedSeconds(start);
+        };
+
+        BPEWordCache::Stats coldBefore = tokenizer.cacheStats();
+        double cold = bestPass(minTime, [&]() {
+            tokenizer.setCacheCapacity(BPEWordCache::DEFAULT_CAPACITY);
+            return encodePass();
+        });
+        double coldHitRate = hitRate(coldBefore, tokenizer.cacheStats());
+
+        encodePass();
+        BPEWordCache::Stats warmBefore = tokenizer.cacheStats();
+        double warm = bestPass(minTime, encodePass);
+        double warmHitRate = hitRate(warmBefore, tokenizer.cacheStats());
+
+        double decode = bestPass(minTime, [&]() {
+            auto start = Clock::now();
+            for (const auto& ids : encoded) {
+                sink += tokenizer.decode(ids).size();
+            }
+            return elapsedSeconds(start);
+        });
+
+        json entry;
+        entry["texts"] = lines.size();
+        entry["bytes"] = bytes;
+        entry["tokens"] = tokens;
+        entry["encode_cold"] = throughput(cold, bytes, tokens);
+        entry["encode_cold"]["cache_hit_rate"] = coldHitRate;
+        entry["encode_warm"] = throughput(warm, bytes, tokens);
+        entry["encode_warm"]["cache_hit_rate"] = warmHitRate;
+        entry["decode"] = throughput(decode, bytes, tokens);
+        result["categories"][category] = entry;
+
+        std::printf("%-16s %8zu %8zu | %10.2f %12.0f %5.1f%% | %10.2f %12.0f %5.1f%% | %10.2f %12.0f\n",
+                    category, bytes, tokens,
+                    entry["encode_cold"]["mb_per_s"].get<double>(),
+                    entry["encode_cold"]["tokens_per_s"].get<double>(), 100.0 * coldHitRate,
+                    entry["encode_warm"]["mb_per_s"].get<double>(),
+                    entry["encode_warm"]["tokens_per_s"].get<double>(), 100.0 * warmHitRate,
+                    entry["decode"]["mb_per_s"].get<double>(),
+                    entry["decode"]["tokens_per_s"].get<double>());
+    }
+    if (sink == 0) {
+        std::cerr << "Error: Nothing was encoded" << std::endl;
+        return 1;
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        out << result.dump(2) << std::endl;
+        if (!out) {
+            std::cerr << "Error: Cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (!baselinePath.empty()) {
+        std::ifstream baselineFile(baselinePath);
+        if (!baselineFile.is_open()) {
+            std::cerr << "Error: Cannot open baseline: " << baselinePath << std::endl;
+            return 1;
+        }
+        json baseline;
+        try {
+            baselineFile >> baseline;
+        } catch (const json::exception& e) {
+            std::cerr << "Error: Cannot parse baseline: " << e.what() << std::endl;
+            return 1;
+        }
+        std::printf("\n");
+        int regressions = countRegressions(baseline, result, tolerance, "");
+        if (regressions > 0) {
+            std::printf("%d regression(s) beyond %.0f%% of %s\n", regressions, 100.0 * tolerance,
+                        baselinePath.c_str());
+            return 2;
+        }
+        std::printf("No regressions beyond %.0f%% of %s\n", 100.0 * tolerance, baselinePath.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef ADDED_TOKEN_MATCHER_HPP
+#define ADDED_TOKEN_MATCHER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Aho-Corasick automaton over the added (special) tokens.
+ *
+ * Finds added tokens such as "[chuckle]" or "<|endoftext|>" in text with
+ * leftmost-longest semantics, like HuggingFace tokenizers: among matches the
+ * one starting first wins, and among those the longest. Matches are returned
+ * as byte spans into the text.
+ *
+ * The automaton is a DFA over byte classes (bytes that occur in no token
+ * share one class), so scanning costs one table load per byte.
+ */
+class AddedTokenMatcher {
+public:
+    struct Match {
+        size_t begin;
+        size_t end;
+        int64_t id;
+    };
+
+    /**
+     * Build the automaton for (content, ID) pairs; empty contents are ignored
+     */
+    void build(const std::vector<std::pair<std::string, int64_t>>& tokens);
+
+    /**
+     * Find the leftmost-longest match in text starting at or after pos
+     */
+    bool findNext(std::string_view text, size_t pos, Match& match) const;
+
+    bool empty() const { return pattern_count == 0; }
+
+private:
+    struct State {
+        int32_t depth = 0;
+        int32_t match_length = 0;   // longest token that is a suffix of this state, 0 if none
+        int64_t match_id = -1;
+    };
+
+    std::array<uint8_t, 256> byte_class{};
+    size_t class_count = 1;
+    std::vector<State> states;
+    std::vector<int32_t> transitions;   // states.size() x class_count
+    size_t pattern_count = 0;
+};
+
+#endif // ADDED_TOKEN_MATCHER_HPP
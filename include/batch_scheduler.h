@@ -0,0 +1,82 @@
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+#include "decode_context.h"
+#include "kv_cache.h"
+#include "logits_processor.h"
+#include "sampler.h"
+
+class ChatterBox;
+
+/**
+ * Continuous batching of speech token generation.
+ *
+ * Requests are prefilled one at a time and then join a shared decode batch, so
+ * every decode step runs the language model once for all in-flight sequences.
+ * Each sequence has its own attention mask row, position id and KV cache row;
+ * sequences leave the batch when they reach STOP_SPEECH_TOKEN or the step cap.
+ *
+ * The scheduler owns the ChatterBox instance's language model state while it
+ * is running: do not call SynthesizeSpeechTokens on the same instance from
+ * other threads meanwhile.
+ */
+class BatchScheduler {
+public:
+    BatchScheduler(ChatterBox& chatterbox, int maxBatchSize = 4);
+    ~BatchScheduler();
+
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    /**
+     * Queue a request. The future receives the same tokens SynthesizeSpeechTokens
+     * would return (starting with START_SPEECH_TOKEN).
+     */
+    std::future<std::vector<int64_t>> submit(std::vector<int64_t> inputIds);
+
+private:
+    struct Request {
+        std::vector<int64_t> inputIds;
+        std::promise<std::vector<int64_t>> result;
+    };
+
+    struct Sequence {
+        std::vector<int64_t> generatedTokens;
+        std::promise<std::vector<int64_t>> result;
+        LogitsProcessor logitsProcessor;
+        std::unique_ptr<Sampler> sampler;   // own copy, so sequences sample independently
+        int64_t length = 0;    // positions in the KV cache, without padding
+        int steps = 0;
+    };
+
+    ChatterBox& chatterbox_;
+    int maxBatchSize_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Request> pending_;
+    bool stopping_ = false;
+
+    std::vector<Sequence> active_;
+    KVCache batchCache_;
+    DecodeContext context_;
+    Ort::IoBinding binding_;
+    std::thread worker_;
+
+    void run();
+    void admit(Request& request);
+    void decodeStep();
+    void reserveBatch(int64_t rows, int64_t length);
+    void finish(Sequence& sequence);
+    void compact();
+};
+
+#endif // BATCH_SCHEDULER_H
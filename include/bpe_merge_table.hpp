@@ -0,0 +1,95 @@
+#ifndef BPE_MERGE_TABLE_HPP
+#define BPE_MERGE_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Flat open-addressing hash from a pair of token IDs to the merge that
+ * combines them: (left, right) -> (rank, merged ID).
+ *
+ * Keys are packed into one 64-bit word and probed linearly, so a lookup is a
+ * multiply, a shift and usually one cache line. The slot array can be owned
+ * by the table or attached from external memory, such as a memory-mapped
+ * compiled tokenizer.
+ */
+class BPEMergeTable {
+public:
+    struct Merge {
+        int32_t rank;
+        int32_t merged_id;
+    };
+
+    /**
+     * One hash slot; an empty slot has key EMPTY_KEY. The layout is part of
+     * the compiled tokenizer format.
+     */
+    struct Slot {
+        uint64_t key;
+        Merge merge;
+    };
+
+    static constexpr uint64_t EMPTY_KEY = ~uint64_t(0);
+
+    BPEMergeTable() = default;
+    BPEMergeTable(const BPEMergeTable&) = delete;
+    BPEMergeTable& operator=(const BPEMergeTable&) = delete;
+
+    /**
+     * Remove all merges and size the table for expected_merges entries
+     */
+    void reset(size_t expected_merges);
+
+    /**
+     * Add a merge; an existing pair keeps its lower rank
+     */
+    void insert(int32_t left, int32_t right, int32_t rank, int32_t merged_id);
+
+    /**
+     * Use slot_count externally owned slots holding merge_count merges.
+     * slot_count must be a power of two and the slots must stay valid while
+     * the table is used. Returns false if the slots are inconsistent.
+     */
+    bool attach(const Slot* external, size_t slot_count, size_t merge_count);
+
+    /**
+     * Look up the merge for (left, right); nullptr if the pair never merges
+     */
+    const Merge* find(int32_t left, int32_t right) const {
+        if (count == 0 || left < 0 || right < 0) {
+            return nullptr;
+        }
+        uint64_t key = packKey(left, right);
+        for (size_t slot = slotFor(key);; slot = (slot + 1) & mask) {
+            const Slot& entry = table[slot];
+            if (entry.key == key) return &entry.merge;
+            if (entry.key == EMPTY_KEY) return nullptr;
+        }
+    }
+
+    size_t size() const { return count; }
+
+    const Slot* data() const { return table; }
+    size_t slotCount() const { return table == nullptr ? 0 : mask + 1; }
+
+private:
+    static uint64_t packKey(int32_t left, int32_t right) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(left)) << 32) |
+               static_cast<uint32_t>(right);
+    }
+
+    size_t slotFor(uint64_t key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    void setSlotCount(size_t slot_count);
+
+    std::vector<Slot> slots;        // owned storage, empty when attached
+    const Slot* table = nullptr;
+    size_t mask = 0;
+    unsigned shift = 64;
+    size_t count = 0;
+};
+
+#endif // BPE_MERGE_TABLE_HPP
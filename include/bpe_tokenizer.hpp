@@ -1,52 +1,74 @@
 #ifndef BPE_TOKENIZER_HPP
 #define BPE_TOKENIZER_HPP
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <unordered_map>
-#include <set>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
-#include <regex>
 #include <cstdint>
 #include <climits>
 
 // JSON library (nlohmann/json)
 #include <nlohmann/json.hpp>
 
+#include "added_token_matcher.hpp"
+#include "bpe_word_cache.hpp"
+#include "thread_pool.hpp"
+#include "tokenizer_tables.hpp"
+
+/**
+ * Token IDs of several texts in CSR layout
+ */
+struct EncodedBatch {
+    // IDs of all texts back to back
+    std::vector<int64_t> ids;
+    
+    // Text i is ids[offsets[i], offsets[i + 1]); one more entry than texts
+    std::vector<size_t> offsets;
+    
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    
+    const int64_t* data(size_t i) const { return ids.data() + offsets[i]; }
+    size_t length(size_t i) const { return offsets[i + 1] - offsets[i]; }
+    
+    /**
+     * Copy of the IDs of text i
+     */
+    std::vector<int64_t> sequence(size_t i) const {
+        return std::vector<int64_t>(data(i), data(i) + length(i));
+    }
+};
+
 /**
  * Byte-level BPE Tokenizer for GPT-2 style models
  * Pure C++ implementation compatible with HuggingFace tokenizers
  */
 class BPETokenizer {
 private:
-    // Vocabulary: token -> ID
-    std::unordered_map<std::string, int64_t> vocab;
-    
-    // Reverse vocabulary: ID -> token
-    std::unordered_map<int64_t, std::string> id_to_token;
-    
-    // BPE merges: pairs of tokens to merge
-    std::vector<std::pair<std::string, std::string>> merges;
+    friend class TokenStreamDecoder;
     
-    // Rank of each merge (lower = applied earlier)
-    std::map<std::pair<std::string, std::string>, int> bpe_ranks;
+    // Vocabulary, merges by token ID and byte-level symbol IDs, built from
+    // tokenizer.json or mapped from a compiled file; shared by copies
+    std::shared_ptr<const TokenizerTables> tables;
     
     // Added tokens (special tokens like [chuckle], [laugh], etc.)
-    std::unordered_map<std::string, int64_t> added_tokens;
+    AddedTokenMatcher added_matcher;
     
-    // Byte encoder/decoder for GPT-2 byte-level encoding
-    std::unordered_map<uint8_t, char32_t> byte_encoder;
-    std::unordered_map<char32_t, uint8_t> byte_decoder;
+    // GPT-2 byte-level encoding: UTF-8 symbol of each byte
+    std::array<std::string, 256> byte_symbols;
     
-    // Cache for BPE operations
-    std::unordered_map<std::string, std::string> cache;
+    // Cache for BPE operations: pre-tokenized piece -> token IDs, kept across
+    // encode calls. Thread-safe, and may be shared with tokenizers that have
+    // the same tables.
+    std::shared_ptr<ShardedBPEWordCache> cache;
     
-    // Pre-tokenization pattern (GPT-2 style)
-    std::regex pattern;
+    // Workers for encodeBatch, nullptr = encode on the calling thread
+    std::shared_ptr<ThreadPool> pool;
     
     // Special token IDs
     int64_t bos_token_id = 50256;
@@ -60,30 +82,46 @@ private:
     void initBytesToUnicode();
     
     /**
-     * Get all adjacent pairs from a word
+     * Working buffers of the merge loop, reused across words (one per thread)
      */
-    std::set<std::pair<std::string, std::string>> getPairs(
-        const std::vector<std::string>& word) const;
+    struct MergeScratch {
+        struct Symbol {
+            int32_t id;
+            int32_t prev;
+            int32_t next;
+        };
+        struct Candidate {
+            int32_t rank;
+            int32_t pos;
+            int32_t left;
+            int32_t right;
+            int32_t merged_id;
+        };
+        std::vector<Symbol> symbols;
+        std::vector<Candidate> queue;
+    };
     
     /**
-     * Apply BPE algorithm to a token
+     * Use newly loaded tables and reset state derived from the old ones
      */
-    std::string bpe(const std::string& token);
+    void setTables(std::shared_ptr<const TokenizerTables> loaded);
     
     /**
-     * Convert UTF-8 string to UTF-32 for proper character handling
+     * Apply BPE to the raw bytes of one pre-tokenized piece and append the
+     * resulting token IDs to output
      */
-    std::u32string utf8ToUtf32(const std::string& str) const;
+    void bpe(std::string_view piece, MergeScratch& scratch, std::vector<int64_t>& output) const;
     
     /**
-     * Convert UTF-32 string back to UTF-8
+     * Encode text that contains no added tokens and append the IDs
      */
-    std::string utf32ToUtf8(const std::u32string& str) const;
+    void encodeOrdinary(std::string_view text, std::vector<int64_t>& token_ids) const;
     
     /**
-     * Split text by added tokens (special tokens)
+     * Encode text and append the IDs
      */
-    std::vector<std::string> splitByAddedTokens(const std::string& text) const;
+    void encodeInto(std::string_view text, bool add_special_tokens,
+                    std::vector<int64_t>& token_ids) const;
 
 public:
     /**
@@ -96,19 +134,50 @@ public:
      */
     bool loadFromFile(const std::string& filepath);
     
+    /**
+     * Load a tokenizer compiled with compile_tokenizer (or saveCompiled).
+     * The file is memory-mapped and used in place.
+     */
+    bool loadCompiled(const std::string& filepath);
+    
+    /**
+     * Write the loaded tokenizer in the compiled format
+     */
+    bool saveCompiled(const std::string& filepath) const;
+    
     /**
      * Encode text to token IDs
      * 
+     * Safe to call concurrently from several threads on one tokenizer.
+     * 
      * @param text Input text to encode
      * @param add_special_tokens If true, adds 2x EOS tokens at end
      * @return Vector of token IDs
      */
     std::vector<int64_t> encode(const std::string& text, 
-                                 bool add_special_tokens = true);
+                                 bool add_special_tokens = true) const;
+    
+    /**
+     * Encode many texts, in parallel if setThreadCount was called. All
+     * threads share the word cache. Same results as calling encode on each.
+     * 
+     * @param texts Texts to encode
+     * @param count Number of texts
+     * @param add_special_tokens If true, adds 2x EOS tokens at the end of each text
+     * @return IDs of all texts in CSR layout
+     */
+    EncodedBatch encodeBatch(const std::string_view* texts, size_t count,
+                             bool add_special_tokens = true) const;
+    
+    EncodedBatch encodeBatch(const std::vector<std::string>& texts,
+                             bool add_special_tokens = true) const;
     
     /**
      * Decode token IDs to text
      * 
+     * Each token is copied from a table of decoded bytes built at load time.
+     * To decode tokens as they are generated, use TokenStreamDecoder.
+     * 
      * @param token_ids Vector of token IDs
      * @param skip_special_tokens If true, skip special tokens in output
      * @return Decoded text
@@ -119,17 +188,43 @@ public:
     /**
      * Get vocabulary size
      */
-    size_t vocabSize() const { return vocab.size(); }
+    size_t vocabSize() const { return tables ? tables->vocabCount() : 0; }
     
     /**
      * Get number of merges
      */
-    size_t mergeCount() const { return merges.size(); }
+    size_t mergeCount() const { return tables ? tables->merges().size() : 0; }
     
     /**
      * Get number of added tokens
      */
-    size_t addedTokenCount() const { return added_tokens.size(); }
+    size_t addedTokenCount() const { return tables ? tables->addedCount() : 0; }
+    
+    /**
+     * Set the maximum number of words kept in the BPE cache (0 disables it).
+     * Clears the cache.
+     */
+    void setCacheCapacity(size_t entries);
+    
+    /**
+     * Use a cache shared with other tokenizers of the same tables (copies of
+     * this tokenizer) instead of the tokenizer's own; nullptr switches back to
+     * a new private cache. Returns false and keeps the current cache if shared
+     * is in use with other tables. Loading another tokenizer file later moves
+     * this tokenizer to a private cache.
+     */
+    bool setSharedCache(std::shared_ptr<ShardedBPEWordCache> shared);
+    
+    /**
+     * Hit/miss statistics of the cache in use
+     */
+    BPEWordCache::Stats cacheStats() const;
+    
+    /**
+     * Number of threads used by encodeBatch, including the caller;
+     * 0 = one per hardware thread, 1 = no worker threads (default)
+     */
+    void setThreadCount(size_t threads);
 };
 
 #endif // BPE_TOKENIZER_HPP
@@ -0,0 +1,150 @@
+#ifndef BPE_WORD_CACHE_HPP
+#define BPE_WORD_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class TokenizerTables;
+
+/**
+ * Bounded cache from a pre-tokenized piece to its BPE token IDs.
+ *
+ * Eviction uses the CLOCK algorithm: every entry has a reference bit that a
+ * hit sets, and a hand sweeps the entries on insert, clearing set bits and
+ * replacing the first entry whose bit is already clear. This approximates LRU
+ * without reordering a list on every hit. Entry storage is reused after
+ * eviction, so a warm cache rarely allocates.
+ *
+ * Not thread-safe; see ShardedBPEWordCache.
+ */
+class BPEWordCache {
+public:
+    /**
+     * Pieces longer than this are not cached
+     */
+    static constexpr size_t MAX_KEY_LENGTH = 256;
+
+    static constexpr size_t DEFAULT_CAPACITY = 32768;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+
+        double hitRate() const {
+            uint64_t lookups = hits + misses;
+            return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+        }
+
+        Stats& operator+=(const Stats& other);
+    };
+
+    explicit BPEWordCache(size_t capacity = DEFAULT_CAPACITY);
+
+    BPEWordCache(const BPEWordCache&) = delete;
+    BPEWordCache& operator=(const BPEWordCache&) = delete;
+
+    /**
+     * Append the cached IDs of piece to output; returns false on a miss
+     */
+    bool lookup(std::string_view piece, std::vector<int64_t>& output);
+
+    /**
+     * Cache the IDs of piece, evicting an entry if the cache is full
+     */
+    void insert(std::string_view piece, const int64_t* ids, size_t count);
+
+    /**
+     * Drop all entries and set the maximum number of entries; 0 disables caching.
+     * Statistics are kept.
+     */
+    void setCapacity(size_t capacity);
+
+    void clear();
+    void resetStats();
+    Stats stats() const;
+
+    size_t size() const { return index.size(); }
+    size_t capacity() const { return max_entries; }
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<int64_t> ids;
+        bool referenced = false;
+    };
+
+    size_t max_entries;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string_view, uint32_t> index;  // keys view into entries[i].key
+    size_t hand = 0;
+    Stats counters;
+};
+
+/**
+ * Thread-safe BPE word cache for tokenizers used from several threads.
+ *
+ * Pieces are distributed over independently locked BPEWordCache shards by
+ * hash, so concurrent lookups of different pieces rarely contend.
+ *
+ * Entries are keyed by piece only, so the IDs are valid for one vocabulary:
+ * a cache is bound to the TokenizerTables of the tokenizers using it and can
+ * only be shared by tokenizers with the same tables.
+ */
+class ShardedBPEWordCache {
+public:
+    /**
+     * capacity is the total number of entries; shards is rounded up to a power of two
+     */
+    explicit ShardedBPEWordCache(size_t capacity = BPEWordCache::DEFAULT_CAPACITY,
+                                 size_t shards = 16);
+
+    bool lookup(std::string_view piece, std::vector<int64_t>& output);
+    void insert(std::string_view piece, const int64_t* ids, size_t count);
+
+    void setCapacity(size_t capacity);
+    void clear();
+    void resetStats();
+
+    /**
+     * Bind the cache to tables. Binding the tables it is already bound to does
+     * nothing; a cache that is unbound or whose tables no longer exist is
+     * cleared first. Returns false if it is bound to other tables still in use.
+     */
+    bool bind(const std::shared_ptr<const TokenizerTables>& tables);
+
+    /**
+     * Clear the cache and bind it to tables, whatever it was bound to
+     */
+    void rebind(const std::shared_ptr<const TokenizerTables>& tables);
+
+    /**
+     * Statistics summed over all shards
+     */
+    BPEWordCache::Stats stats() const;
+
+private:
+    struct Shard {
+        mutable std::mutex mutex;
+        BPEWordCache cache{0};
+    };
+
+    Shard& shardFor(std::string_view piece);
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shard_count;
+
+    std::mutex binding_mutex;
+    std::weak_ptr<const TokenizerTables> bound_tables;
+};
+
+#endif // BPE_WORD_CACHE_HPP
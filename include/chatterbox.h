@@ -1,45 +1,147 @@
 #include <iostream>
 
+#include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 #include <fstream>
-#include <unordered_set>
 #include <algorithm>
 #include <onnxruntime_cxx_api.h>
+#include "chatterbox_config.h"
+#include "decode_context.h"
+#include "kv_cache.h"
+#include "logits_processor.h"
+#include "request_arena.h"
+#include "sampler.h"
+#include "streaming_vocoder.h"
+#include "synthesis_metrics.h"
+
+class BPETokenizer;
+
+// Result of ChatterBox::synthesize
+struct SynthesisResult {
+    std::vector<int64_t> speechTokens;      // starting with START_SPEECH_TOKEN
+    std::vector<int16_t> pcm;
+    SynthesisMetrics metrics;
+};
 
 class ChatterBox{
+    friend class BatchScheduler;
+    friend struct ChatterBoxTestAccess;
 public:
     ChatterBox() = delete;
     ChatterBox(const std::string modelDir, bool useCuda);
+    ChatterBox(const std::string modelDir, const ChatterBoxConfig& config);
     virtual ~ChatterBox();
     std::vector<int64_t> TokenizeText(std::string text);
+    // Receives the speech tokens generated since the previous call. isFinal is set on the
+    // last call once generation ends (newTokens may be empty). Return false to stop generation.
+    using SpeechTokenCallback = std::function<bool(const std::vector<int64_t>& newTokens, bool isFinal)>;
     std::vector<int64_t> SynthesizeSpeechTokens(std::vector<int64_t> inputIds);
+    std::vector<int64_t> SynthesizeSpeechTokens(std::vector<int64_t> inputIds,
+                                                const SpeechTokenCallback& callback,
+                                                int callbackInterval = 1);
     std::vector<int16_t> synthesizeSpeech(std::vector<int64_t> generatedTokens);
+    // Receives consecutive int16 PCM chunks, isFinal marks the last one. Return false to stop synthesis.
+    using AudioCallback = std::function<bool(const std::vector<int16_t>& pcm, bool isFinal)>;
+    // Generates speech tokens and vocodes them in chunks while they are produced
+    std::vector<int64_t> synthesizeSpeechStreaming(std::vector<int64_t> inputIds,
+                                                   const AudioCallback& onAudio,
+                                                   const StreamingOptions& options = StreamingOptions());
+    // Speech tokens and audio of one request, with its stage timings
+    SynthesisResult synthesize(std::vector<int64_t> inputIds);
+    // Same, starting from text; tokenization is timed too
+    SynthesisResult synthesize(const BPETokenizer& tokenizer, const std::string& text);
+    // Timings of the last SynthesizeSpeechTokens, synthesizeSpeech, synthesizeSpeechStreaming or synthesize call
+    const SynthesisMetrics& lastMetrics() const { return metrics; }
     void LoadStyle(std::string styleDir);
     std::vector<float> LoadBinaryFile(std::string fileName);
     std::vector<int64_t> LoadBinaryFileInt64(std::string fileName);
     float repetitionPenalty = 1.2f; 
+    // Replace the sampler built from ChatterBoxConfig::sampling. Each request starts
+    // with sampler->reset(), so a seeded sampler gives the same tokens for the same input.
+    void setSampler(std::unique_ptr<Sampler> newSampler);
+    // Memory use of the arenas serving sessions created with SessionConfig::requestArena:
+    // one for the language model and embeddings, one for the conditional decoder
+    RequestArena::Stats languageModelArenaStats() const { return languageModelArena.stats(); }
+    RequestArena::Stats vocoderArenaStats() const { return vocoderArena.stats(); }
+    // Look up generated speech tokens in a table extracted from embed_tokens.onnx
+    // at load time instead of running the session once per decode step.
+    bool useEmbeddingTable = true;
+    // Upper bound on the positions (cond_emb + text + generated) held in the KV
+    // cache. Each request sizes the cache to its prompt plus MAX_SPEECH_TOKENS.
+    int64_t maxContextLength = 2048;
+    // Append the metrics of every request as a JSON line to this file, empty = off
+    std::string metricsLogPath;
     const int64_t START_SPEECH_TOKEN = 6561;
     const int64_t STOP_SPEECH_TOKEN = 6562;
+    const int64_t SPEECH_VOCAB_SIZE = 6563;
+    const int64_t HIDDEN_SIZE = 1024;
+    const int64_t NUM_LAYERS = 24;
+    const int64_t NUM_HEADS = 16;
+    const int64_t HEAD_DIM = 64;
+    const int64_t MAX_SPEECH_TOKENS = 1024;     // decode steps per request
     const float MAX_WAV_VALUE = 32767.0f;
+    const int SAMPLE_RATE = 24000;
 private:
     
-    Ort::Env env_;
-    Ort::SessionOptions sessionOptions_;
-    Ort::Session conditionalDecoder;
-    Ort::Session embedTokens;
-    Ort::Session languageModel;
+    // Owned by ModelRegistry and shared between instances
+    std::shared_ptr<Ort::Session> conditionalDecoder;
+    std::shared_ptr<Ort::Session> embedTokens;
+    std::shared_ptr<Ort::Session> languageModel;
+    // Declared before anything that may hold ORT values allocated from them.
+    // Separate because streaming runs the two stages on different threads.
+    RequestArena languageModelArena;
+    RequestArena vocoderArena;
     Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(
         OrtAllocatorType::OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+    Ort::IoBinding languageModelBinding;
+    KVCache kvCache{NUM_LAYERS, NUM_HEADS, HEAD_DIM};
+    // Width of the language model's logits, read from the model at load time
+    // (SPEECH_VOCAB_SIZE if the model leaves it dynamic)
+    int64_t logitsVocabSize = SPEECH_VOCAB_SIZE;
+    DecodeContext decodeContext{HIDDEN_SIZE, SPEECH_VOCAB_SIZE};
 
     std::vector<float>condEmb;
     std::vector<int64_t>promptToken;
     std::vector<float>speakerEmbeddings;
     std::vector<float>speakerFeatures;
 
+    // KV state of the language model after consuming condEmb, one [1,16,len,64] tensor per past_key_values input
+    std::vector<std::vector<float>>condPrefixKeyValues;
+    int64_t condPrefixLength = 0;
+
+    // [SPEECH_VOCAB_SIZE, HIDDEN_SIZE] rows of embed_tokens.onnx for speech token ids
+    std::shared_ptr<const std::vector<float>>speechEmbeddingTable;
+
+    // Metrics of the current or last request. Public calls nest (synthesize calls
+    // SynthesizeSpeechTokens), so only the outermost one starts and completes them.
+    struct MetricsScope {
+        explicit MetricsScope(ChatterBox& owner);
+        ~MetricsScope();
+        ChatterBox& owner;
+    };
+    using MetricsClock = std::chrono::steady_clock;
+    SynthesisMetrics metrics;
+    MetricsClock::time_point requestStart;
+    int requestDepth = 0;
+    std::vector<double> decodeStepMs;
+    double msSince(MetricsClock::time_point start) const;
+
+    // Test hook, called with true before and false after each phase of every
+    // decode step after the prefill. Host covers buffer setup, embedding lookup,
+    // token selection and bookkeeping; Binding covers rebinding the language
+    // model inputs and outputs. Only languageModel->Run is outside the brackets
+    enum class DecodeStepPhase { Host, Binding };
+    void (*decodeStepProbe)(DecodeStepPhase phase, bool active) = nullptr;
+
+    // Repetition penalty state of the current request and the token sampler
+    LogitsProcessor logitsProcessor{1.0f, SPEECH_VOCAB_SIZE};
+    std::unique_ptr<Sampler> sampler;
+
     std::array<const char*, 1> embedTokensInputNames = {"input_ids"};
     std::array<const char *, 1> bertEncoderOutputNames = {"inputs_embeds"};
 
@@ -152,5 +254,19 @@ private:
     std::array<const char*, 3> conditionalDecoderInputNames = {"speech_tokens", "speaker_embeddings", "speaker_features"};
     std::array<const char*, 1> conditionalDecoderOutputNames = {"waveform"};
 
-    void applyRepetitionPenalty(float* logits, int64_t vocabSize, const std::vector<int64_t>& generatedTokens, float penalty);
+    std::vector<int64_t> synthesizeSpeechPipelined(std::vector<int64_t> inputIds,
+                                                   const AudioCallback& onAudio,
+                                                   const StreamingOptions& options);
+    std::vector<float> decodeWaveform(const std::vector<int64_t>& tokens, bool appendSilence);
+    std::vector<int16_t> convertToPcm16(const std::vector<float>& audio);
+    float* prefillText(std::vector<int64_t>& inputIds);
+    int64_t selectNextToken(float* logits, int64_t vocabSize, LogitsProcessor& processor, Sampler& tokenSampler);
+    // Runs the positions shaped by decodeContext.prepare() and returns the logits of the last one
+    float* runLanguageModel(float* embeds);
+    // The two halves of runLanguageModel, split so the decode loop can probe the binding
+    void bindLanguageModel(float* embeds);
+    float* runBoundLanguageModel();
+    void prefillConditioning();
+    std::vector<float> buildSpeechEmbeddingTable();
+    void embedSpeechToken(int64_t tokenId, float* dst);
 };
\ No newline at end of file
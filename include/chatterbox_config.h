@@ -0,0 +1,83 @@
+#ifndef CHATTERBOX_CONFIG_H
+#define CHATTERBOX_CONFIG_H
+
+#include <cstdint>
+#include <string>
+#include <onnxruntime_cxx_api.h>
+#include "sampler.h"
+
+/**
+ * ONNX Runtime options for one session
+ */
+struct SessionConfig {
+    GraphOptimizationLevel optimizationLevel = GraphOptimizationLevel::ORT_DISABLE_ALL;
+    int intraOpThreads = 0;         // 0 = ORT default (one per physical core)
+    int interOpThreads = 0;         // only used with ORT_PARALLEL
+    ExecutionMode executionMode = ExecutionMode::ORT_SEQUENTIAL;
+    bool enableCpuMemArena = false;
+    bool enableMemPattern = false;
+    bool denormalsAsZero = false;   // flush denormal floats to zero in the session's threads
+    bool requestArena = false;      // allocate from the running request's RequestArena
+};
+
+/**
+ * ChatterBox construction settings.
+ *
+ * Defaults reproduce the original hardcoded behavior. Settings can be read from
+ * a JSON file:
+ *
+ * {
+ *   "use_cuda": false,
+ *   "use_embedding_table": true,
+ *   "max_context_length": 2048,
+ *   "repetition_penalty": 1.2,
+ *   "sampling": { "temperature": 0.8, "top_k": 50, "top_p": 0.95, "min_p": 0.05, "seed": 42 },
+ *   "optimized_model_cache_dir": "ModelCache",
+ *   "metrics_log": "metrics.jsonl",
+ *   "sessions": {
+ *     "default":             { "graph_optimization_level": "all", "intra_op_threads": 8 },
+ *     "language_model":      { "cpu_mem_arena": true, "mem_pattern": true, "request_arena": true },
+ *     "conditional_decoder": { "execution_mode": "parallel", "inter_op_threads": 2 },
+ *     "embed_tokens":        { "graph_optimization_level": "basic" }
+ *   }
+ * }
+ *
+ * Each session starts from "default" and applies its own keys on top. Session
+ * keys: graph_optimization_level ("disable_all", "basic", "extended", "all"),
+ * intra_op_threads, inter_op_threads, execution_mode ("sequential",
+ * "parallel"), cpu_mem_arena, mem_pattern, denormals_as_zero, request_arena.
+ *
+ * Without "sampling" (or with temperature 0) the next token is chosen greedily.
+ */
+struct ChatterBoxConfig {
+    bool useCuda = false;
+    bool useEmbeddingTable = true;
+    int64_t maxContextLength = 2048;
+    float repetitionPenalty = 1.2f;
+    SamplingConfig sampling;
+    // Directory for pre-optimized models (see createCachedSession), empty = disabled
+    std::string optimizedModelCacheDir;
+    // File receiving one JSON line of SynthesisMetrics per request, empty = disabled
+    std::string metricsLog;
+
+    SessionConfig languageModel;
+    SessionConfig conditionalDecoder;
+    SessionConfig embedTokens;
+
+    /**
+     * Load settings from a JSON file; keys that are absent keep their values
+     */
+    bool loadFromFile(const std::string& filepath);
+
+    /**
+     * Load settings from a JSON string
+     */
+    bool loadFromString(const std::string& text);
+};
+
+/**
+ * Build ORT session options from a session config
+ */
+Ort::SessionOptions createSessionOptions(const SessionConfig& config, bool useCuda);
+
+#endif // CHATTERBOX_CONFIG_H
@@ -0,0 +1,71 @@
+#ifndef DECODE_CONTEXT_H
+#define DECODE_CONTEXT_H
+
+#include <cstdint>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * Reusable input and output buffers of the language model.
+ *
+ * inputs_embeds, attention_mask, position_ids and logits are views over
+ * buffers that only grow. Once reserve() has sized them for the longest
+ * context, a decode step writes into the same memory every time and the
+ * logits land there directly through Ort::IoBinding, so the decode loop makes
+ * no heap allocations of its own. ONNX Runtime still creates a small tensor
+ * object for each bound buffer.
+ */
+class DecodeContext {
+public:
+    DecodeContext(int64_t hiddenSize, int64_t vocabSize);
+
+    /**
+     * Size the buffers for batchSize rows of up to maxLength positions, of
+     * which up to maxNewTokens are added by one run
+     */
+    void reserve(int64_t batchSize, int64_t maxLength, int64_t maxNewTokens);
+
+    /**
+     * Shape the buffers for one run: batchSize rows each adding newTokens
+     * positions after pastLength cached ones. The mask is set to all ones and
+     * the positions to pastLength onwards; batched callers then adjust them
+     * per row. Grows the buffers if reserve() was too small, keeping the
+     * embeddings already written.
+     */
+    void prepare(int64_t batchSize, int64_t pastLength, int64_t newTokens);
+
+    /**
+     * Bind inputs_embeds, attention_mask and position_ids (inputNames[0..2])
+     * and the logits output. embeds may point to another buffer holding
+     * [batch, newTokens, hidden] values, which is then used without a copy.
+     */
+    void bind(Ort::IoBinding& binding, const Ort::MemoryInfo& memoryInfo,
+              const char* const* inputNames, const char* logitsName, float* embeds = nullptr);
+
+    float* embeds() { return embeds_.data(); }              // [batch, newTokens, hidden]
+    int64_t* attentionMask() { return mask_.data(); }       // [batch, pastLength + newTokens]
+    int64_t* positionIds() { return positionIds_.data(); }  // [batch, newTokens]
+    float* logits() { return logits_.data(); }              // [batch, newTokens, vocab]
+
+    /**
+     * Logits of the last new position of a row
+     */
+    float* lastLogits(int64_t row) { return logits_.data() + ((row + 1) * newTokens_ - 1) * vocabSize_; }
+
+    int64_t newTokens() const { return newTokens_; }
+    int64_t vocabSize() const { return vocabSize_; }
+
+private:
+    int64_t hiddenSize_;
+    int64_t vocabSize_;
+    int64_t batchSize_ = 0;
+    int64_t totalLength_ = 0;
+    int64_t newTokens_ = 0;
+
+    std::vector<float> embeds_;
+    std::vector<int64_t> mask_;
+    std::vector<int64_t> positionIds_;
+    std::vector<float> logits_;
+};
+
+#endif // DECODE_CONTEXT_H
@@ -0,0 +1,115 @@
+#ifndef KV_CACHE_H
+#define KV_CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * Preallocated key/value cache for the language model decode loop.
+ *
+ * language_model.onnx takes past_key_values.* of shape [B, H, past, D] and
+ * returns present.* of shape [B, H, past + new, D]. Every tensor is backed by
+ * two buffers sized for the longest sequence expected: each step reads the
+ * past from one side and ORT writes the present straight into the other
+ * through Ort::IoBinding, then the sides swap. No buffer is allocated or moved
+ * per step. The buffers are not zero-filled, as every position is written
+ * before it is read, so memory the sequence never reaches is not touched.
+ *
+ * A batch is stored as one contiguous [B, H, len, D] tensor with every row
+ * right-aligned to the same length.
+ */
+class KVCache {
+public:
+    KVCache(int64_t numLayers, int64_t numHeads, int64_t headDim);
+
+    /**
+     * Allocate buffers for batchSize sequences of up to maxLength positions
+     * and empty the cache. Existing buffers are kept if they are large enough,
+     * and grown to the larger of the old and new sizes otherwise.
+     */
+    void reserve(int64_t batchSize, int64_t maxLength);
+
+    /**
+     * Make room for batchSize rows of maxLength positions without emptying
+     * the cache: the cached positions are moved into the larger buffers
+     */
+    void grow(int64_t batchSize, int64_t maxLength);
+
+    /**
+     * Rearrange the batch for continuous batching. Row r of the new batch is
+     * old row keepRows[r], right-aligned to newLength positions: shorter rows
+     * get zero left padding (to be masked out by the attention mask) and
+     * leading positions beyond newLength are dropped.
+     */
+    void relayout(const std::vector<int64_t>& keepRows, int64_t newLength);
+
+    /**
+     * Add a sequence taken by snapshot() as the last batch row, left-padded
+     * to the current length. rowLength must not exceed length().
+     */
+    void appendRow(const std::vector<std::vector<float>>& tensors, int64_t rowLength);
+
+    /**
+     * Drop the cached positions, keeping the allocation
+     */
+    void reset() { length_ = 0; prefix_ = nullptr; }
+
+    /**
+     * Copy the cached positions of every tensor out (batch size 1)
+     */
+    void snapshot(std::vector<std::vector<float>>& tensors) const;
+
+    /**
+     * Replace the cache contents with tensors taken by snapshot(), without
+     * copying them: until the next advance() the past is read straight from
+     * tensors, which must stay unchanged until then, and the first run writes
+     * its present into the cache. Throws std::length_error if length positions
+     * do not fit the cache.
+     */
+    void restore(const std::vector<std::vector<float>>& tensors, int64_t length);
+
+    /**
+     * Bind past_key_values.* (current length) as inputs and present.*
+     * (current length + newTokens) as outputs of the language model.
+     */
+    void bind(Ort::IoBinding& binding, const Ort::MemoryInfo& memoryInfo,
+              const char* const* pastNames, const char* const* presentNames,
+              int64_t newTokens);
+
+    /**
+     * Commit the present outputs written by the last run as the new past
+     */
+    void advance(int64_t newTokens);
+
+    int64_t length() const { return length_; }
+    int64_t capacity() const { return capacity_; }
+    int64_t batchSize() const { return batchSize_; }
+    int64_t rowCapacity() const { return rowCapacity_; }
+    int64_t tensorCount() const { return numLayers_ * 2; }
+
+private:
+    int64_t numLayers_;
+    int64_t numHeads_;
+    int64_t headDim_;
+    int64_t batchSize_ = 0;
+    int64_t rowCapacity_ = 0;
+    int64_t capacity_ = 0;
+    int64_t length_ = 0;
+    int current_ = 0;
+
+    // Snapshot holding the past instead of buffers_[current_], set by restore()
+    const std::vector<std::vector<float>>* prefix_ = nullptr;
+
+    const float* pastData(int64_t tensor) const {
+        return prefix_ ? (*prefix_)[tensor].data() : buffers_[current_][tensor].get();
+    }
+
+    // buffers_[side][tensor], tensor = 2 * layer + (0 = key, 1 = value);
+    // uninitialized until written
+    std::array<std::vector<std::unique_ptr<float[]>>, 2> buffers_;
+};
+
+#endif // KV_CACHE_H
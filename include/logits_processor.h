@@ -0,0 +1,76 @@
+#ifndef LOGITS_PROCESSOR_H
+#define LOGITS_PROCESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Vectorized kernels over the logits of one decode step.
+ *
+ * The instruction set is chosen once at runtime from the CPU: AVX-512 or AVX2
+ * on x86-64, NEON on AArch64, plain C++ otherwise. Results match the scalar
+ * loops exactly: NaN logits are ignored and ties go to the lowest index.
+ */
+namespace logits {
+
+/**
+ * Largest value, -infinity if count is 0 or every value is NaN
+ */
+float maxValue(const float* values, int64_t count);
+
+/**
+ * Index of the first largest value (greedy token), 0 if there is none
+ */
+int64_t argmax(const float* values, int64_t count);
+
+/**
+ * Name of the kernels in use: "avx512", "avx2", "neon" or "scalar"
+ */
+const char* kernelName();
+
+} // namespace logits
+
+/**
+ * Per-sequence logit adjustments before sampling; currently the repetition
+ * penalty.
+ *
+ * Generated tokens are recorded as they are produced in a bitset plus a list
+ * of distinct tokens, so penalizing a step costs O(distinct tokens) instead of
+ * rebuilding a set from the whole history.
+ */
+class LogitsProcessor {
+public:
+    /**
+     * vocabSize only sizes the initial bitset; larger IDs grow it
+     */
+    explicit LogitsProcessor(float repetitionPenalty = 1.0f, int64_t vocabSize = 0);
+
+    /**
+     * Forget all tokens, for a new sequence
+     */
+    void reset();
+
+    /**
+     * Record a generated token
+     */
+    void observe(int64_t tokenId);
+
+    /**
+     * Penalize every recorded token below vocabSize: positive logits are
+     * divided by the penalty, negative ones multiplied
+     */
+    void apply(float* logits, int64_t vocabSize) const;
+
+    void setRepetitionPenalty(float penalty) { repetitionPenalty = penalty; }
+    float getRepetitionPenalty() const { return repetitionPenalty; }
+
+    size_t seenCount() const { return seenTokens.size(); }
+
+private:
+    float repetitionPenalty;
+    std::vector<uint64_t> seenBits;
+    std::vector<int64_t> seenTokens;    // distinct recorded tokens, in first-seen order
+};
+
+#endif // LOGITS_PROCESSOR_H
@@ -0,0 +1,42 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <string>
+#include <onnxruntime_cxx_api.h>
+#include "chatterbox_config.h"
+
+/**
+ * Create a session for modelPath, reusing a pre-optimized copy of the model.
+ *
+ * The first time a model is loaded with a given option set, ORT writes the
+ * optimized graph to cacheDir/<model>.<key>.onnx. Later loads read that file
+ * with graph optimizations disabled. The key hashes the session options and,
+ * separately, the model file, the size and modification time of its external
+ * data files, and the ORT version, so changing any of them creates a new entry;
+ * an entry left behind by an older model or ORT version with the same options
+ * is removed. The optimized weights are stored in a .data file next to the
+ * graph, so models over 2 GB can be cached; if ORT cannot write the cache the
+ * model is loaded uncached. Optimized graphs can depend on the CPU they
+ * were produced on, so a cache directory should not be shared between machine
+ * types. With an empty cacheDir or optimizations disabled the model is loaded
+ * directly.
+ *
+ * Sessions created with the same prepackedWeights container share their
+ * prepacked weight buffers.
+ */
+Ort::Session createCachedSession(const Ort::Env& env, const std::string& modelPath,
+                                 const SessionConfig& config, bool useCuda,
+                                 const std::string& cacheDir,
+                                 OrtPrepackedWeightsContainer* prepackedWeights = nullptr);
+
+/**
+ * Canonical text form of the options that affect the optimized graph
+ */
+std::string describeSessionOptions(const SessionConfig& config, bool useCuda);
+
+/**
+ * Cache key for a model file under the given options: "<options>.<model>" in hex
+ */
+std::string modelCacheKey(const std::string& modelPath, const SessionConfig& config, bool useCuda);
+
+#endif // MODEL_CACHE_H
@@ -0,0 +1,67 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <onnxruntime_cxx_api.h>
+#include "chatterbox_config.h"
+
+/**
+ * Process-wide owner of ONNX Runtime sessions.
+ *
+ * Every ChatterBox instance asks the registry for its sessions instead of
+ * creating its own. A model loaded with the same path, session options and
+ * cache directory is created once and handed out to every caller, so N
+ * instances keep one copy of the weights. Session::Run is thread-safe; each
+ * instance keeps its own IoBinding and KV cache.
+ *
+ * All sessions live in one Ort::Env and are created with a shared
+ * Ort::PrepackedWeightsContainer, so sessions over the same weights with
+ * different options (for example a latency and a throughput preset) also
+ * share their prepacked GEMM weights. Sharing is within the process: ORT
+ * copies the weights into each session, so separate processes each hold
+ * their own. requestArenaAllocator() is registered with the Env for sessions
+ * created with SessionConfig::requestArena.
+ *
+ * Sessions are released when the last instance using them is destroyed.
+ */
+class ModelRegistry {
+public:
+    static ModelRegistry& instance();
+
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+    /**
+     * Return the session for modelPath under config, creating it on first use
+     */
+    std::shared_ptr<Ort::Session> getSession(const std::string& modelPath,
+                                             const SessionConfig& config, bool useCuda,
+                                             const std::string& cacheDir);
+
+    /**
+     * Return the float table registered under key, calling build to create it
+     * on first use. Used for data derived from a shared session, such as the
+     * speech embedding table.
+     */
+    std::shared_ptr<const std::vector<float>> getTable(
+        const std::string& key, const std::function<std::vector<float>()>& build);
+
+    const Ort::Env& env() const { return env_; }
+
+private:
+    ModelRegistry();
+
+    Ort::Env env_;
+    Ort::PrepackedWeightsContainer prepackedWeights_;
+
+    std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<Ort::Session>> sessions_;
+    std::map<std::string, std::weak_ptr<const std::vector<float>>> tables_;
+};
+
+#endif // MODEL_REGISTRY_H
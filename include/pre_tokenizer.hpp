@@ -0,0 +1,37 @@
+#ifndef PRE_TOKENIZER_HPP
+#define PRE_TOKENIZER_HPP
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * GPT-2 pre-tokenizer.
+ *
+ * Splits UTF-8 text into the pieces matched by the GPT-2 pattern
+ *
+ *   's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+ *
+ * with a single forward scan instead of a regex engine. Pieces are views into
+ * the input, so splitting does not allocate. Malformed UTF-8 bytes are
+ * treated as punctuation.
+ *
+ * Usage:
+ *   PreTokenizer splitter(text);
+ *   std::string_view piece;
+ *   while (splitter.next(piece)) { ... }
+ */
+class PreTokenizer {
+public:
+    explicit PreTokenizer(std::string_view input) : text(input) {}
+
+    /**
+     * Store the next piece in piece; returns false at the end of the text
+     */
+    bool next(std::string_view& piece);
+
+private:
+    std::string_view text;
+    size_t pos = 0;
+};
+
+#endif // PRE_TOKENIZER_HPP
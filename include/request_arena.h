@@ -0,0 +1,86 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <onnxruntime_cxx_api.h>
+
+/**
+ * Arena for the CPU memory ONNX Runtime allocates while a request runs.
+ *
+ * New blocks are carved in order from a list of 64-byte aligned chunks. Block
+ * sizes are rounded to size classes, and a freed block goes to the free list
+ * of its class, where the next block of that class picks it up; so the
+ * intermediates of one run reuse each other's memory, and so do the steps of
+ * runs that overlap on several threads. Once every block is freed the free
+ * lists are dropped and carving starts again at the first chunk. reset()
+ * returns the chunks the previous request did not need to the system.
+ *
+ * Sessions opt in with SessionConfig::requestArena. They then allocate through
+ * requestArenaAllocator(), which serves each thread from the arena made active
+ * on it by a RequestArenaScope and falls back to the heap otherwise (session
+ * creation, ORT worker threads). Blocks record where they came from, so either
+ * kind can be freed from any thread. Stages that run concurrently, like the
+ * language model and the vocoder of a streaming request, should use separate
+ * arenas so neither holds on to the other's memory.
+ */
+class RequestArena {
+public:
+    struct Stats {
+        size_t capacity = 0;            // bytes held in chunks
+        size_t peak = 0;                // most bytes in use at once, padding included
+        uint64_t allocations = 0;       // blocks served
+        uint64_t reused = 0;            // blocks placed in memory an earlier block had used
+        uint64_t chunks = 0;            // chunks obtained from the system
+    };
+
+    explicit RequestArena(size_t chunkSize = size_t(4) << 20);
+
+    /**
+     * Blocks still in use when the arena is destroyed stay valid; the memory
+     * is released with the last of them
+     */
+    ~RequestArena();
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    /**
+     * Start of a request: if no block is in use, free the chunks at the end
+     * that nothing was carved from since the previous reset()
+     */
+    void reset();
+
+    Stats stats() const;
+
+    struct State;
+
+private:
+    State* state_;
+
+    friend class RequestArenaScope;
+};
+
+/**
+ * Makes an arena the target of requestArenaAllocator() on the current thread
+ * for the scope's lifetime. Scopes nest.
+ */
+class RequestArenaScope {
+public:
+    explicit RequestArenaScope(RequestArena& arena);
+    ~RequestArenaScope();
+
+    RequestArenaScope(const RequestArenaScope&) = delete;
+    RequestArenaScope& operator=(const RequestArenaScope&) = delete;
+
+private:
+    RequestArena::State* previous_;
+};
+
+/**
+ * Process-wide CPU OrtAllocator backed by the active request arena; registered
+ * with the Env by ModelRegistry
+ */
+OrtAllocator* requestArenaAllocator();
+
+#endif // REQUEST_ARENA_H
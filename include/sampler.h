@@ -0,0 +1,89 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Next-token sampling settings. The defaults select greedily (argmax).
+ */
+struct SamplingConfig {
+    float temperature = 0.0f;   // <= 0 = greedy
+    int topK = 0;               // keep the k most likely tokens, 0 = all
+    float topP = 1.0f;          // keep the smallest set with this much probability, 1 = all
+    float minP = 0.0f;          // drop tokens below minP times the top probability, 0 = none
+    uint64_t seed = 0;          // the same seed and input give the same tokens
+};
+
+/**
+ * Picks the next token from the logits of one decode step
+ */
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+
+    /**
+     * Choose a token ID from vocabSize logits
+     */
+    virtual int64_t sample(const float* logits, int64_t vocabSize) = 0;
+
+    /**
+     * Start a new sequence; seeded samplers restart their random sequence
+     */
+    virtual void reset() {}
+
+    /**
+     * Independent sampler with the same settings, e.g. one per concurrent sequence
+     */
+    virtual std::unique_ptr<Sampler> clone() const = 0;
+};
+
+/**
+ * Always the most likely token; the lowest ID wins ties
+ */
+class GreedySampler : public Sampler {
+public:
+    int64_t sample(const float* logits, int64_t vocabSize) override;
+    std::unique_ptr<Sampler> clone() const override;
+};
+
+/**
+ * Random sampling with temperature, top-k, top-p and min-p filtering.
+ *
+ * Filters are applied in the order top-k, top-p, min-p, as in HuggingFace
+ * generate. Top-k is a partial selection (nth_element) and top-p bisects the
+ * candidates by probability mass with nth_element, so a step costs expected
+ * O(V) and never sorts the vocabulary. Working buffers are reused across
+ * steps.
+ */
+class StochasticSampler : public Sampler {
+public:
+    explicit StochasticSampler(const SamplingConfig& config);
+
+    int64_t sample(const float* logits, int64_t vocabSize) override;
+    void reset() override;
+    std::unique_ptr<Sampler> clone() const override;
+
+private:
+    struct Candidate {
+        float logit;
+        float weight;       // probability relative to the most likely candidate
+        int64_t id;
+    };
+
+    // Uniform double in [0, 1); same sequence on every standard library
+    double uniform();
+
+    SamplingConfig config;
+    std::mt19937_64 rng;
+    std::vector<Candidate> candidates;
+};
+
+/**
+ * GreedySampler when config.temperature <= 0 or topK == 1, StochasticSampler otherwise
+ */
+std::unique_ptr<Sampler> createSampler(const SamplingConfig& config);
+
+#endif // SAMPLER_H
@@ -0,0 +1,72 @@
+#ifndef STREAMING_VOCODER_H
+#define STREAMING_VOCODER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Chunking parameters for streaming synthesis
+ */
+struct StreamingOptions {
+    // Speech tokens whose audio is emitted per decoder run (25 tokens = 1 s)
+    int chunkTokens = 25;
+    // Future tokens decoded past the chunk so its right edge is not cut off
+    int lookaheadTokens = 5;
+    // Already emitted tokens decoded again before the chunk as left context
+    int contextTokens = 50;
+    // Samples cross-faded between consecutive chunks (limited by the lookahead)
+    int crossfadeSamples = 480;
+    // Generate tokens on a worker thread while the calling thread vocodes finished chunks
+    bool pipelined = false;
+    // Token batches buffered between the two threads before generation waits for the vocoder
+    int queueCapacity = 64;
+};
+
+/**
+ * Turns a growing sequence of speech tokens into audio chunks.
+ *
+ * Each window passed to the decoder is [context | chunk | lookahead]; only the
+ * chunk part is emitted. The audio decoded for the start of the lookahead is
+ * kept and cross-faded with the beginning of the next chunk.
+ */
+class StreamingVocoder {
+public:
+    // Decodes a window of speech tokens into waveform samples. isFinal marks the
+    // window that ends the utterance.
+    using DecodeFunction = std::function<std::vector<float>(const std::vector<int64_t>& tokens, bool isFinal)>;
+    // Receives consecutive waveform chunks. Return false to stop synthesis.
+    using AudioSink = std::function<bool(const std::vector<float>& samples, bool isFinal)>;
+
+    StreamingVocoder(const StreamingOptions& options, DecodeFunction decode, AudioSink sink);
+
+    /**
+     * Append generated tokens and emit every chunk that is ready
+     *
+     * @return false once the sink asked to stop
+     */
+    bool push(const std::vector<int64_t>& tokens);
+
+    /**
+     * Decode and emit the remaining tokens
+     */
+    bool finish();
+
+    bool cancelled() const { return cancelled_; }
+
+private:
+    StreamingOptions options_;
+    DecodeFunction decode_;
+    AudioSink sink_;
+
+    std::vector<int64_t> tokens_;
+    size_t committed_ = 0;          // tokens whose audio has been emitted
+    double samplesPerToken_ = 0.0;
+    std::vector<float> tail_;       // audio following the last emitted chunk
+    bool cancelled_ = false;
+    bool finished_ = false;
+
+    void decodeChunk(size_t chunkEnd, bool isFinal);
+};
+
+#endif // STREAMING_VOCODER_H
@@ -0,0 +1,54 @@
+#ifndef SYNTHESIS_METRICS_H
+#define SYNTHESIS_METRICS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Timings of one synthesis request, in milliseconds from the request start.
+ *
+ * Stages that did not run in the request (tokenization when token IDs were
+ * passed in, audio when only speech tokens were generated) stay 0.
+ */
+struct SynthesisMetrics {
+    double tokenizeMs = 0.0;
+    double prefillMs = 0.0;             // text embedding and language model prefill
+    int decodeSteps = 0;                // language model runs after the prefill
+    double decodeMs = 0.0;              // all decode steps
+    double decodeStepP50Ms = 0.0;
+    double decodeStepP99Ms = 0.0;
+    double vocoderMs = 0.0;             // conditional decoder runs
+    double pcmMs = 0.0;                 // float to int16 conversion
+    int64_t speechTokens = 0;           // generated, without START_SPEECH_TOKEN
+    double tokensPerSecond = 0.0;       // speechTokens over prefill + decode time
+    double timeToFirstTokenMs = 0.0;
+    double timeToFirstAudioMs = 0.0;    // first PCM chunk ready
+    double audioSeconds = 0.0;
+    double totalMs = 0.0;
+    double realTimeFactor = 0.0;        // totalMs over the audio duration, below 1 is faster than real time
+
+    /**
+     * Set the decode step count, total and percentiles from per-step times;
+     * reorders stepMs
+     */
+    void setDecodeSteps(std::vector<double>& stepMs);
+
+    /**
+     * Set totalMs and the rates derived from the stage timings
+     */
+    void finish(double requestMs);
+
+    /**
+     * The metrics as a single-line JSON object
+     */
+    std::string toJson() const;
+};
+
+/**
+ * Append metrics to path as one JSON line. Lines from concurrent requests
+ * are not interleaved.
+ */
+bool appendMetricsLine(const std::string& path, const SynthesisMetrics& metrics);
+
+#endif // SYNTHESIS_METRICS_H
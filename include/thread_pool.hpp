@@ -0,0 +1,62 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads for data-parallel loops.
+ *
+ * parallelFor hands out loop indices from a shared counter, so uneven work
+ * items balance themselves. The calling thread takes part in the loop, so a
+ * pool of size 1 has no workers and runs everything inline.
+ */
+class ThreadPool {
+public:
+    /**
+     * threads is the total number of threads running a loop, including the
+     * caller; 0 = one per hardware thread
+     */
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Run task(i) for every i in [0, count) and wait for all of them. The
+     * first exception thrown by a task is rethrown here. Calls from several
+     * threads are serialized.
+     */
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+    size_t size() const { return workers.size() + 1; }
+
+private:
+    void workerLoop();
+    void runTasks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex loop_mutex;              // one parallelFor at a time
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+
+    const std::function<void(size_t)>* current = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next_task{0};
+    std::exception_ptr error;
+};
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,56 @@
+#ifndef TOKEN_STREAM_DECODER_HPP
+#define TOKEN_STREAM_DECODER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "tokenizer_tables.hpp"
+
+class BPETokenizer;
+
+/**
+ * Incremental decoding of a token stream, e.g. for captions shown while
+ * audio is generated.
+ *
+ * A byte-level token can end in the middle of a multi-byte UTF-8 character.
+ * push() holds such a partial character back until the tokens completing it
+ * arrive, so every chunk it returns ends on a character boundary. Joining
+ * all chunks and finish() gives exactly BPETokenizer::decode of the same IDs.
+ */
+class TokenStreamDecoder {
+public:
+    /**
+     * Decode with the tables of tokenizer; keeps them alive if the
+     * tokenizer is reloaded or destroyed
+     */
+    explicit TokenStreamDecoder(const BPETokenizer& tokenizer, bool skip_special_tokens = true);
+
+    /**
+     * Append the text completed by token id to text; returns the number of
+     * bytes appended, 0 while a character is still incomplete
+     */
+    size_t push(int64_t id, std::string& text);
+
+    std::string push(int64_t id);
+
+    /**
+     * Return bytes still held back at the end of the stream (a truncated
+     * character) and start a new stream
+     */
+    std::string finish();
+
+    /**
+     * Drop held-back bytes and start a new stream
+     */
+    void reset() { pending_size = 0; }
+
+private:
+    std::shared_ptr<const TokenizerTables> tables;
+    int64_t skip_id;                    // token left out of the text, -1 for none
+    char pending[3];                    // start of an incomplete character
+    size_t pending_size = 0;
+};
+
+#endif // TOKEN_STREAM_DECODER_HPP
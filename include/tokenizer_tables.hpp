@@ -0,0 +1,132 @@
+#ifndef TOKENIZER_TABLES_HPP
+#define TOKENIZER_TABLES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "bpe_merge_table.hpp"
+#include "mapped_file.h"
+
+/**
+ * Immutable lookup tables of a loaded BPE tokenizer.
+ *
+ * All tables live in one contiguous blob, which is also the compiled
+ * tokenizer file format (see compile_tokenizer). A blob built from
+ * tokenizer.json and a blob memory-mapped from a compiled file are used the
+ * same way: the accessors read the blob in place, so loading a compiled file
+ * only maps it and checks its bounds.
+ *
+ * Blob layout, native endianness, every section 8-byte aligned:
+ *   header
+ *   token offsets   uint32[id_count + 1]   bytes of token i: [offsets[i], offsets[i + 1])
+ *   sorted IDs      uint32[vocab_count]    IDs ordered by token bytes, for string -> ID
+ *   merge slots     BPEMergeTable::Slot[merge_slot_count]
+ *   added tokens    uint32[added_count]    IDs of added (special) tokens
+ *   byte symbols    int32[256]             ID of the byte-level symbol of each byte, -1 if none
+ *   token bytes     char[string_bytes]     byte-level token strings
+ *   raw offsets     uint32[id_count + 1]   decoded bytes of token i: [raw[i], raw[i + 1])
+ *   raw bytes       char[raw_bytes]        tokens decoded to bytes; added tokens verbatim
+ */
+class TokenizerTables {
+public:
+    /**
+     * Build tables from parsed tokenizer.json contents. tokens maps token
+     * strings to IDs; when two strings share an ID the later one is returned
+     * by token(). byte_symbols holds the byte-level symbol of each byte.
+     * Returns nullptr if an ID is out of range.
+     */
+    static std::shared_ptr<const TokenizerTables> build(
+        const std::vector<std::pair<std::string, int64_t>>& tokens,
+        const std::vector<std::pair<std::string, std::string>>& merges,
+        const std::vector<int64_t>& added_ids,
+        const std::array<std::string, 256>& byte_symbols);
+
+    /**
+     * Memory-map a compiled tokenizer file; nullptr on error
+     */
+    static std::shared_ptr<const TokenizerTables> map(const std::string& filepath);
+
+    /**
+     * Write the blob to filepath
+     */
+    bool save(const std::string& filepath) const;
+
+    TokenizerTables(const TokenizerTables&) = delete;
+    TokenizerTables& operator=(const TokenizerTables&) = delete;
+
+    /**
+     * Byte-level string of a token, empty if the ID is unused
+     */
+    std::string_view token(int64_t id) const {
+        if (id < 0 || static_cast<uint64_t>(id) >= id_count) return {};
+        return std::string_view(token_data + token_offsets[id],
+                                token_offsets[id + 1] - token_offsets[id]);
+    }
+
+    /**
+     * Bytes a token decodes to, empty if the ID is unused
+     */
+    std::string_view tokenBytes(int64_t id) const {
+        if (id < 0 || static_cast<uint64_t>(id) >= id_count) return {};
+        return std::string_view(raw_token_data + raw_token_offsets[id],
+                                raw_token_offsets[id + 1] - raw_token_offsets[id]);
+    }
+
+    /**
+     * ID of a byte-level token string, -1 if not in the vocabulary
+     */
+    int64_t find(std::string_view token) const;
+
+    /**
+     * Largest token ID + 1
+     */
+    size_t idCount() const { return id_count; }
+
+    /**
+     * Number of distinct token strings
+     */
+    size_t vocabCount() const { return vocab_count; }
+
+    const BPEMergeTable& merges() const { return merge_table; }
+    const int32_t* byteSymbolIds() const { return byte_ids; }
+
+    const uint32_t* addedTokenIds() const { return added_ids; }
+    size_t addedCount() const { return added_count; }
+
+    const char* blobData() const { return blob; }
+    size_t blobSize() const { return blob_size; }
+
+private:
+    TokenizerTables() = default;
+
+    /**
+     * Validate the blob and point the accessors into it
+     */
+    bool attach(const char* data, size_t size);
+
+    std::vector<uint64_t> owned;  // blob built in memory, 8-byte aligned
+    MappedFile file;              // or the mapped compiled file
+
+    const char* blob = nullptr;
+    size_t blob_size = 0;
+
+    size_t id_count = 0;
+    size_t vocab_count = 0;
+    size_t added_count = 0;
+    const uint32_t* token_offsets = nullptr;
+    const uint32_t* sorted_ids = nullptr;
+    const uint32_t* added_ids = nullptr;
+    const int32_t* byte_ids = nullptr;
+    const char* token_data = nullptr;
+    const uint32_t* raw_token_offsets = nullptr;
+    const char* raw_token_data = nullptr;
+    BPEMergeTable merge_table;
+};
+
+#endif // TOKENIZER_TABLES_HPP
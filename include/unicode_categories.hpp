@@ -0,0 +1,29 @@
+#ifndef UNICODE_CATEGORIES_HPP
+#define UNICODE_CATEGORIES_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Unicode character classes used by the GPT-2 pre-tokenizer
+ */
+namespace unicode {
+
+/**
+ * \p{L}: general category Lu, Ll, Lt, Lm or Lo
+ */
+bool isLetter(char32_t cp);
+
+/**
+ * \p{N}: general category Nd, Nl or No
+ */
+bool isNumber(char32_t cp);
+
+/**
+ * \s: the White_Space property
+ */
+bool isWhitespace(char32_t cp);
+
+} // namespace unicode
+
+#endif // UNICODE_CATEGORIES_HPP
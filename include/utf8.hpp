@@ -0,0 +1,118 @@
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * UTF-8 decoding, encoding and validation without locale machinery
+ */
+namespace unicode {
+
+/**
+ * Decode one UTF-8 sequence from [p, end) into cp and return its length.
+ * Malformed, overlong or truncated sequences decode as a single byte with
+ * cp = U+FFFD, so every input byte belongs to exactly one code point.
+ */
+inline size_t decodeUtf8(const char* p, const char* end, char32_t& cp) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+    size_t available = static_cast<size_t>(end - p);
+    unsigned char lead = s[0];
+
+    if (lead < 0x80) {
+        cp = lead;
+        return 1;
+    }
+
+    size_t length;
+    char32_t min;
+    if ((lead & 0xE0) == 0xC0) {
+        length = 2; min = 0x80; cp = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3; min = 0x800; cp = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4; min = 0x10000; cp = lead & 0x07;
+    } else {
+        cp = 0xFFFD;
+        return 1;
+    }
+
+    if (available < length) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    for (size_t i = 1; i < length; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            cp = 0xFFFD;
+            return 1;
+        }
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        cp = 0xFFFD;
+        return 1;
+    }
+    return length;
+}
+
+/**
+ * Write the UTF-8 encoding of cp to out and return its length (1-4).
+ * Surrogates and values above U+10FFFF are written as U+FFFD.
+ */
+inline size_t encodeUtf8(char32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        cp = 0xFFFD;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/**
+ * Length of the longest prefix of [data, data + size) that is valid UTF-8.
+ * ASCII runs are checked 16 bytes at a time with SSE2 or NEON when available.
+ */
+size_t validUtf8Prefix(const char* data, size_t size);
+
+inline bool isValidUtf8(const char* data, size_t size) {
+    return validUtf8Prefix(data, size) == size;
+}
+
+/**
+ * Number of bytes at the end of [data, data + size) that start a multi-byte
+ * sequence but are too few to complete it (0-3). Used to hold back a code
+ * point split across chunks until the rest arrives.
+ */
+inline size_t incompleteUtf8Suffix(const char* data, size_t size) {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(data);
+    for (size_t back = 1; back <= 3 && back <= size; back++) {
+        unsigned char c = s[size - back];
+        if ((c & 0xC0) == 0x80) {
+            continue;
+        }
+        size_t length = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return length > back ? back : 0;
+    }
+    return 0;
+}
+
+} // namespace unicode
+
+#endif // UTF8_HPP
@@ -17,10 +17,10 @@ int main(){
 
     std::string text = "Hello, welcome to my world!";
 
-    std::vector<int64_t> inputIds = tokenizer.encode(text, true);
+    SynthesisResult result = chatterbox.synthesize(tokenizer, text);
+    std::vector<int16_t>& audioBuffer = result.pcm;
+    std::cout << "Metrics: " << result.metrics.toJson() << std::endl;
 
-    std::vector<int64_t> generatedTokens = chatterbox.SynthesizeSpeechTokens(inputIds);
-    std::vector<int16_t> audioBuffer = chatterbox.synthesizeSpeech(generatedTokens);
     std::ofstream audioFile("test.wav", std::ios::binary);
     writeWavHeader(24000, 2, 1, (int32_t)audioBuffer.size(), audioFile);
     audioFile.write((const char *)audioBuffer.data(), sizeof(int16_t) * audioBuffer.size());
@@ -0,0 +1,99 @@
+#include "added_token_matcher.hpp"
+#include <queue>
+
+void AddedTokenMatcher::build(const std::vector<std::pair<std::string, int64_t>>& tokens) {
+    // Bytes that occur in a token get their own class, all others share class 0
+    byte_class.fill(0);
+    class_count = 1;
+    for (const auto& token : tokens) {
+        for (unsigned char c : token.first) {
+            if (byte_class[c] == 0) {
+                byte_class[c] = static_cast<uint8_t>(class_count++);
+            }
+        }
+    }
+
+    // Trie; -1 marks a missing edge until failure links fill it in
+    states.assign(1, State());
+    transitions.assign(class_count, -1);
+    pattern_count = 0;
+    for (const auto& [content, id] : tokens) {
+        if (content.empty()) continue;
+        int32_t state = 0;
+        for (unsigned char c : content) {
+            int32_t& edge = transitions[state * class_count + byte_class[c]];
+            if (edge < 0) {
+                edge = static_cast<int32_t>(states.size());
+                State child;
+                child.depth = states[state].depth + 1;
+                states.push_back(child);
+                transitions.resize(states.size() * class_count, -1);
+            }
+            state = transitions[state * class_count + byte_class[c]];
+        }
+        states[state].match_length = states[state].depth;
+        states[state].match_id = id;
+        pattern_count++;
+    }
+
+    // Breadth-first: complete the DFA with failure transitions and inherit
+    // the longest suffix match from the failure state
+    std::vector<int32_t> failure(states.size(), 0);
+    std::queue<int32_t> pending;
+    for (size_t cls = 0; cls < class_count; cls++) {
+        int32_t& edge = transitions[cls];
+        if (edge < 0) {
+            edge = 0;
+        } else {
+            failure[edge] = 0;
+            pending.push(edge);
+        }
+    }
+    while (!pending.empty()) {
+        int32_t state = pending.front();
+        pending.pop();
+        if (states[state].match_length == 0) {
+            states[state].match_length = states[failure[state]].match_length;
+            states[state].match_id = states[failure[state]].match_id;
+        }
+        for (size_t cls = 0; cls < class_count; cls++) {
+            int32_t& edge = transitions[state * class_count + cls];
+            int32_t fallback = transitions[failure[state] * class_count + cls];
+            if (edge < 0) {
+                edge = fallback;
+            } else {
+                failure[edge] = fallback;
+                pending.push(edge);
+            }
+        }
+    }
+}
+
+bool AddedTokenMatcher::findNext(std::string_view text, size_t pos, Match& match) const {
+    if (pattern_count == 0) {
+        return false;
+    }
+
+    bool found = false;
+    int32_t state = 0;
+    for (size_t i = pos; i < text.size(); i++) {
+        state = transitions[state * class_count + byte_class[static_cast<unsigned char>(text[i])]];
+        const State& current = states[state];
+
+        // Every partial match still alive starts at or after the current
+        // state's start, so nothing can beat a match that starts earlier
+        size_t live_start = i + 1 - current.depth;
+        if (found && live_start > match.begin) {
+            return true;
+        }
+
+        if (current.match_length > 0) {
+            size_t begin = i + 1 - current.match_length;
+            if (!found || begin <= match.begin) {
+                match = Match{begin, i + 1, current.match_id};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,226 @@
+#include "batch_scheduler.h"
+#include "chatterbox.h"
+#include <algorithm>
+
+BatchScheduler::BatchScheduler(ChatterBox& chatterbox, int maxBatchSize)
+    : chatterbox_(chatterbox),
+      maxBatchSize_(std::max(maxBatchSize, 1)),
+      batchCache_(chatterbox.NUM_LAYERS, chatterbox.NUM_HEADS, chatterbox.HEAD_DIM),
+      context_(chatterbox.HIDDEN_SIZE, chatterbox.logitsVocabSize),
+      binding_(*chatterbox.languageModel) {
+    // The batch cache grows with the sequences it holds (see reserveBatch)
+    context_.reserve(maxBatchSize_, chatterbox_.maxContextLength, 1);
+    batchCache_.relayout({}, 0);
+    worker_ = std::thread(&BatchScheduler::run, this);
+}
+
+BatchScheduler::~BatchScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+    worker_.join();
+}
+
+std::future<std::vector<int64_t>> BatchScheduler::submit(std::vector<int64_t> inputIds) {
+    Request request;
+    request.inputIds = std::move(inputIds);
+    std::future<std::vector<int64_t>> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(request));
+    }
+    wakeup_.notify_one();
+    return result;
+}
+
+void BatchScheduler::run() {
+    // Sequences overlap, so the arena is never reset; steps reuse each other's freed blocks
+    RequestArenaScope arenaScope(chatterbox_.languageModelArena);
+    while (true) {
+        std::vector<Request> admitted;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this]() {
+                return stopping_ || !pending_.empty() || !active_.empty();
+            });
+            // Outstanding requests are completed before the worker exits
+            if (stopping_ && pending_.empty() && active_.empty()) {
+                return;
+            }
+            while (!pending_.empty() &&
+                   static_cast<int>(active_.size() + admitted.size()) < maxBatchSize_) {
+                admitted.push_back(std::move(pending_.front()));
+                pending_.pop_front();
+            }
+        }
+
+        for (auto& request : admitted) {
+            try {
+                admit(request);
+            } catch (...) {
+                request.result.set_exception(std::current_exception());
+            }
+        }
+
+        if (active_.empty()) {
+            continue;
+        }
+
+        try {
+            decodeStep();
+        } catch (...) {
+            for (auto& sequence : active_) {
+                if (sequence.length >= 0) {
+                    sequence.result.set_exception(std::current_exception());
+                }
+            }
+            active_.clear();
+            batchCache_.relayout({}, 0);
+        }
+    }
+}
+
+void BatchScheduler::admit(Request& request) {
+    Sequence sequence;
+    sequence.generatedTokens.reserve(static_cast<size_t>(chatterbox_.MAX_SPEECH_TOKENS) + 1);
+    sequence.generatedTokens.push_back(chatterbox_.START_SPEECH_TOKEN);
+    sequence.logitsProcessor = LogitsProcessor(chatterbox_.repetitionPenalty, chatterbox_.logitsVocabSize);
+    sequence.logitsProcessor.observe(chatterbox_.START_SPEECH_TOKEN);
+    sequence.sampler = chatterbox_.sampler->clone();
+
+    // Prefill runs on its own (batch 1) on the instance's KV cache
+    float* lastTokenLogits = chatterbox_.prefillText(request.inputIds);
+    int64_t tokenId = chatterbox_.selectNextToken(lastTokenLogits, context_.vocabSize(), sequence.logitsProcessor,
+                                                  *sequence.sampler);
+    sequence.length = chatterbox_.kvCache.length();
+    sequence.steps = 1;
+    if (tokenId != chatterbox_.STOP_SPEECH_TOKEN) {
+        sequence.generatedTokens.push_back(tokenId);
+    }
+    if (tokenId == chatterbox_.STOP_SPEECH_TOKEN || sequence.length + 1 > chatterbox_.maxContextLength) {
+        sequence.result = std::move(request.result);
+        finish(sequence);
+        return;
+    }
+
+    // Join the decode batch, padding the existing rows if this sequence is longer
+    std::vector<std::vector<float>> keyValues;
+    chatterbox_.kvCache.snapshot(keyValues);
+    reserveBatch(static_cast<int64_t>(active_.size()) + 1, std::max(sequence.length, batchCache_.length()));
+    if (sequence.length > batchCache_.length()) {
+        std::vector<int64_t> keepRows(active_.size());
+        for (size_t r = 0; r < keepRows.size(); r++) keepRows[r] = static_cast<int64_t>(r);
+        batchCache_.relayout(keepRows, sequence.length);
+    }
+    batchCache_.appendRow(keyValues, sequence.length);
+    sequence.result = std::move(request.result);
+    active_.push_back(std::move(sequence));
+}
+
+void BatchScheduler::decodeStep() {
+    // Sequences that cannot take another position leave before the step
+    bool anyFull = false;
+    for (auto& sequence : active_) {
+        if (sequence.length + 1 > chatterbox_.maxContextLength) {
+            finish(sequence);
+            anyFull = true;
+        }
+    }
+    if (anyFull || batchCache_.length() + 1 > chatterbox_.maxContextLength) {
+        compact();
+        if (active_.empty()) {
+            return;
+        }
+    }
+
+    const int64_t hiddenSize = chatterbox_.HIDDEN_SIZE;
+    int64_t batchSize = static_cast<int64_t>(active_.size());
+    int64_t pastLength = batchCache_.length();
+    int64_t totalLength = pastLength + 1;
+    reserveBatch(batchSize, totalLength);
+
+    context_.prepare(batchSize, pastLength, 1);
+    int64_t* mask = context_.attentionMask();
+    int64_t* posIds = context_.positionIds();
+    for (int64_t b = 0; b < batchSize; b++) {
+        const Sequence& sequence = active_[b];
+        chatterbox_.embedSpeechToken(sequence.generatedTokens.back(), context_.embeds() + b * hiddenSize);
+
+        // Left padding of shorter rows is masked out
+        int64_t padding = pastLength - sequence.length;
+        std::fill(mask + b * totalLength, mask + b * totalLength + padding, 0);
+        posIds[b] = sequence.length;
+    }
+
+    binding_.ClearBoundInputs();
+    binding_.ClearBoundOutputs();
+    context_.bind(binding_, chatterbox_.memoryInfo,
+        chatterbox_.languageModelInputNames.data(), chatterbox_.languageModelOutputNames[0]);
+    batchCache_.bind(binding_, chatterbox_.memoryInfo,
+        chatterbox_.languageModelInputNames.data() + 3, chatterbox_.languageModelOutputNames.data() + 1, 1);
+
+    chatterbox_.languageModel->Run(Ort::RunOptions{nullptr}, binding_);
+    batchCache_.advance(1);
+
+    // Output 0: Logits [Batch, 1, Vocab]
+    float* logitsRaw = context_.logits();
+    int64_t vocabSize = context_.vocabSize();
+    bool anyFinished = false;
+    for (int64_t b = 0; b < batchSize; b++) {
+        Sequence& sequence = active_[b];
+        sequence.length++;
+        sequence.steps++;
+
+        int64_t tokenId = chatterbox_.selectNextToken(logitsRaw + b * vocabSize, vocabSize, sequence.logitsProcessor,
+                                                      *sequence.sampler);
+        if (tokenId != chatterbox_.STOP_SPEECH_TOKEN) {
+            sequence.generatedTokens.push_back(tokenId);
+        }
+        if (tokenId == chatterbox_.STOP_SPEECH_TOKEN || sequence.steps >= chatterbox_.MAX_SPEECH_TOKENS) {
+            finish(sequence);
+            anyFinished = true;
+        }
+    }
+
+    if (anyFinished) {
+        compact();
+    }
+}
+
+// Grow the batch cache to rows sequences of length positions. The length grows
+// by half each time, so a batch whose sequences get longer every step only
+// reallocates now and then, and never beyond maxContextLength.
+void BatchScheduler::reserveBatch(int64_t rows, int64_t length) {
+    if (rows <= batchCache_.rowCapacity() && length <= batchCache_.capacity()) {
+        return;
+    }
+    int64_t capacity = batchCache_.capacity();
+    if (length > capacity) {
+        capacity = std::max(length, std::min(capacity + capacity / 2, chatterbox_.maxContextLength));
+    }
+    batchCache_.grow(rows, capacity);
+}
+
+// Finished sequences are marked with length -1 until compact() removes them
+void BatchScheduler::finish(Sequence& sequence) {
+    sequence.result.set_value(std::move(sequence.generatedTokens));
+    sequence.length = -1;
+}
+
+void BatchScheduler::compact() {
+    // Drop finished rows and the padding no remaining row needs
+    std::vector<int64_t> keepRows;
+    std::vector<Sequence> remaining;
+    int64_t newLength = 0;
+    for (size_t r = 0; r < active_.size(); r++) {
+        if (active_[r].length >= 0) {
+            keepRows.push_back(static_cast<int64_t>(r));
+            newLength = std::max(newLength, active_[r].length);
+            remaining.push_back(std::move(active_[r]));
+        }
+    }
+    batchCache_.relayout(keepRows, newLength);
+    active_ = std::move(remaining);
+}
@@ -0,0 +1,80 @@
+#include "bpe_merge_table.hpp"
+
+void BPEMergeTable::setSlotCount(size_t slot_count) {
+    unsigned bits = 0;
+    while ((size_t(1) << bits) < slot_count) {
+        bits++;
+    }
+    mask = slot_count - 1;
+    shift = 64 - bits;
+}
+
+void BPEMergeTable::reset(size_t expected_merges) {
+    // Keep the load factor at or below 1/2
+    size_t capacity = 16;
+    while (capacity < expected_merges * 2) {
+        capacity <<= 1;
+    }
+
+    slots.assign(capacity, Slot{EMPTY_KEY, Merge{0, 0}});
+    table = slots.data();
+    setSlotCount(capacity);
+    count = 0;
+}
+
+bool BPEMergeTable::attach(const Slot* external, size_t slot_count, size_t merge_count) {
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0 || merge_count >= slot_count) {
+        return false;
+    }
+
+    // The probe loop in find() relies on at least one empty slot
+    size_t used = 0;
+    for (size_t i = 0; i < slot_count; i++) {
+        if (external[i].key != EMPTY_KEY) used++;
+    }
+    if (used != merge_count) {
+        return false;
+    }
+
+    slots.clear();
+    slots.shrink_to_fit();
+    table = external;
+    setSlotCount(slot_count);
+    count = merge_count;
+    return true;
+}
+
+void BPEMergeTable::insert(int32_t left, int32_t right, int32_t rank, int32_t merged_id) {
+    if (left < 0 || right < 0) {
+        return;
+    }
+    if (slots.empty() || (count + 1) * 2 > slots.size()) {
+        // Grow and rehash; this also copies an attached table into owned storage
+        std::vector<Slot> old(table, table + slotCount());
+        reset((count + 1) * 2);
+        for (const Slot& entry : old) {
+            if (entry.key != EMPTY_KEY) {
+                insert(static_cast<int32_t>(entry.key >> 32),
+                       static_cast<int32_t>(entry.key & 0xFFFFFFFFu),
+                       entry.merge.rank, entry.merge.merged_id);
+            }
+        }
+    }
+
+    uint64_t key = packKey(left, right);
+    for (size_t slot = slotFor(key);; slot = (slot + 1) & mask) {
+        Slot& entry = slots[slot];
+        if (entry.key == key) {
+            if (rank < entry.merge.rank) {
+                entry.merge = Merge{rank, merged_id};
+            }
+            return;
+        }
+        if (entry.key == EMPTY_KEY) {
+            entry.key = key;
+            entry.merge = Merge{rank, merged_id};
+            count++;
+            return;
+        }
+    }
+}
@@ -1,17 +1,13 @@
 #include "bpe_tokenizer.hpp"
-#include <codecvt>
-#include <locale>
+#include "pre_tokenizer.hpp"
+#include "utf8.hpp"
 
 using json = nlohmann::json;
 
-BPETokenizer::BPETokenizer() {
+BPETokenizer::BPETokenizer()
+    : cache(std::make_shared<ShardedBPEWordCache>()) {
     // Initialize byte encoder/decoder
     initBytesToUnicode();
-    
-    // GPT-2 pre-tokenization pattern
-    pattern = std::regex(
-        R"('s|'t|'re|'ve|'m|'ll|'d| ?[a-zA-Z]+| ?[0-9]+| ?[^\s\w]+|\s+(?!\S)|\s+)"
-    );
 }
 
 void BPETokenizer::initBytesToUnicode() {
@@ -36,10 +32,11 @@ void BPETokenizer::initBytesToUnicode() {
         }
     }
     
-    // Create encoder/decoder maps
+    // Create encoder table
     for (size_t i = 0; i < bs.size(); i++) {
-        byte_encoder[static_cast<uint8_t>(bs[i])] = static_cast<char32_t>(cs[i]);
-        byte_decoder[static_cast<char32_t>(cs[i])] = static_cast<uint8_t>(bs[i]);
+        char utf8[4];
+        size_t length = unicode::encodeUtf8(static_cast<char32_t>(cs[i]), utf8);
+        byte_symbols[bs[i]].assign(utf8, length);
     }
 }
 
@@ -55,26 +52,26 @@ bool BPETokenizer::loadFromFile(const std::string& filepath) {
         file >> config;
         
         // Load vocabulary
+        std::vector<std::pair<std::string, int64_t>> tokens;
         if (config.contains("model") && config["model"].contains("vocab")) {
             for (auto& [token, id] : config["model"]["vocab"].items()) {
-                vocab[token] = id.get<int64_t>();
-                id_to_token[id.get<int64_t>()] = token;
+                tokens.push_back({token, id.get<int64_t>()});
             }
         }
         
-        // Load added tokens (special tokens)
+        // Load added tokens (special tokens), also part of the vocabulary
+        std::vector<int64_t> added_ids;
         if (config.contains("added_tokens")) {
             for (auto& token_info : config["added_tokens"]) {
                 std::string content = token_info["content"].get<std::string>();
                 int64_t id = token_info["id"].get<int64_t>();
-                added_tokens[content] = id;
-                // Also add to vocab
-                vocab[content] = id;
-                id_to_token[id] = content;
+                tokens.push_back({content, id});
+                added_ids.push_back(id);
             }
         }
         
         // Load merges
+        std::vector<std::pair<std::string, std::string>> merges;
         if (config.contains("model") && config["model"].contains("merges")) {
             auto& merges_data = config["model"]["merges"];
             for (auto& merge : merges_data) {
@@ -94,13 +91,14 @@ bool BPETokenizer::loadFromFile(const std::string& filepath) {
             }
         }
         
-        // Build merge ranks
-        for (size_t i = 0; i < merges.size(); i++) {
-            bpe_ranks[merges[i]] = i;
+        auto built = TokenizerTables::build(tokens, merges, added_ids, byte_symbols);
+        if (!built) {
+            return false;
         }
+        setTables(std::move(built));
         
-        std::cout << "Loaded tokenizer: " << vocab.size() << " tokens, "
-                  << merges.size() << " merges, " << added_tokens.size() 
+        std::cout << "Loaded tokenizer: " << vocabSize() << " tokens, "
+                  << merges.size() << " merges, " << addedTokenCount() 
                   << " added tokens" << std::endl;
         
         return true;
@@ -111,293 +109,255 @@ bool BPETokenizer::loadFromFile(const std::string& filepath) {
     }
 }
 
-std::set<std::pair<std::string, std::string>> BPETokenizer::getPairs(
-    const std::vector<std::string>& word) const {
-    
-    std::set<std::pair<std::string, std::string>> pairs;
-    
-    if (word.size() < 2) return pairs;
-    
-    for (size_t i = 0; i < word.size() - 1; i++) {
-        pairs.insert({word[i], word[i + 1]});
+bool BPETokenizer::loadCompiled(const std::string& filepath) {
+    auto mapped = TokenizerTables::map(filepath);
+    if (!mapped) {
+        return false;
     }
-    
-    return pairs;
+    setTables(std::move(mapped));
+    return true;
 }
 
-std::string BPETokenizer::bpe(const std::string& token) {
-    // Check cache
-    if (cache.find(token) != cache.end()) {
-        return cache[token];
+bool BPETokenizer::saveCompiled(const std::string& filepath) const {
+    if (!tables) {
+        std::cerr << "Error: No tokenizer loaded" << std::endl;
+        return false;
     }
+    return tables->save(filepath);
+}
+
+void BPETokenizer::setTables(std::shared_ptr<const TokenizerTables> loaded) {
+    tables = std::move(loaded);
     
-    // Start with individual UTF-8 characters (not bytes!)
-    std::vector<std::string> word;
-    std::u32string u32token = utf8ToUtf32(token);
-    for (char32_t c : u32token) {
-        std::u32string u32char(1, c);
-        word.push_back(utf32ToUtf8(u32char));
+    std::vector<std::pair<std::string, int64_t>> added_tokens;
+    for (size_t i = 0; i < tables->addedCount(); i++) {
+        int64_t id = tables->addedTokenIds()[i];
+        added_tokens.push_back({std::string(tables->token(id)), id});
     }
-    
-    if (word.size() == 1) {
-        return token;
+    added_matcher.build(added_tokens);
+    // The cached IDs belong to the previous vocabulary. A cache no other
+    // tokenizer uses is cleared; a shared one is left to its other users and
+    // replaced by a private cache unless it can be bound to the new tables.
+    if (cache.use_count() == 1) {
+        cache->rebind(tables);
+    } else if (!cache->bind(tables)) {
+        cache = std::make_shared<ShardedBPEWordCache>(cache->stats().capacity);
+        cache->bind(tables);
     }
+}
+
+void BPETokenizer::bpe(std::string_view piece, MergeScratch& scratch,
+                       std::vector<int64_t>& output) const {
+    using Symbol = MergeScratch::Symbol;
+    using Candidate = MergeScratch::Candidate;
     
-    while (true) {
-        auto pairs = getPairs(word);
-        if (pairs.empty()) break;
-        
-        // Find pair with minimum rank
-        std::pair<std::string, std::string> bigram;
-        int min_rank = INT_MAX;
-        bool found = false;
-        
-        for (const auto& pair : pairs) {
-            auto it = bpe_ranks.find(pair);
-            if (it != bpe_ranks.end() && it->second < min_rank) {
-                min_rank = it->second;
-                bigram = pair;
-                found = true;
-            }
-        }
-        
-        if (!found) break;
-        
-        // Merge the bigram
-        std::string first = bigram.first;
-        std::string second = bigram.second;
-        std::vector<std::string> new_word;
-        
-        size_t i = 0;
-        while (i < word.size()) {
-            // Find next occurrence of first
-            auto it = std::find(word.begin() + i, word.end(), first);
-            if (it == word.end()) {
-                // Copy remaining elements
-                new_word.insert(new_word.end(), word.begin() + i, word.end());
-                break;
-            }
-            
-            // Copy elements before the match
-            new_word.insert(new_word.end(), word.begin() + i, it);
-            i = it - word.begin();
-            
-            // Check if we can merge
-            if (i < word.size() - 1 && word[i] == first && word[i + 1] == second) {
-                new_word.push_back(first + second);
-                i += 2;
-            } else {
-                new_word.push_back(word[i]);
-                i++;
-            }
-        }
-        
-        word = new_word;
-        if (word.size() == 1) break;
+    if (!tables) {
+        output.push_back(unk_token_id);
+        return;
     }
+    const BPEMergeTable& merge_table = tables->merges();
+    const int32_t* byte_ids = tables->byteSymbolIds();
     
-    // Join with spaces
-    std::string result;
-    for (size_t i = 0; i < word.size(); i++) {
-        result += word[i];
-        if (i < word.size() - 1) result += " ";
+    // Start with one symbol per byte, linked in a list
+    auto& symbols = scratch.symbols;
+    symbols.clear();
+    for (size_t i = 0; i < piece.size(); i++) {
+        int32_t pos = static_cast<int32_t>(i);
+        symbols.push_back(Symbol{byte_ids[static_cast<unsigned char>(piece[i])],
+                                 pos - 1,
+                                 i + 1 < piece.size() ? pos + 1 : -1});
     }
     
-    cache[token] = result;
-    return result;
-}
-
-std::u32string BPETokenizer::utf8ToUtf32(const std::string& str) const {
-    std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
-    return converter.from_bytes(str);
-}
-
-std::string BPETokenizer::utf32ToUtf8(const std::u32string& str) const {
-    std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
-    return converter.to_bytes(str);
-}
-
-std::vector<std::string> BPETokenizer::splitByAddedTokens(const std::string& text) const {
-    std::vector<std::string> parts = {text};
-    std::vector<bool> is_special(1, false);
+    // Min-heap of mergeable adjacent pairs by (rank, position), so equal
+    // ranks merge left to right
+    auto& queue = scratch.queue;
+    queue.clear();
+    auto later = [](const Candidate& a, const Candidate& b) {
+        return a.rank != b.rank ? a.rank > b.rank : a.pos > b.pos;
+    };
+    auto push_pair = [&](int32_t pos) {
+        int32_t next = symbols[pos].next;
+        if (next < 0) return;
+        const BPEMergeTable::Merge* merge = merge_table.find(symbols[pos].id, symbols[next].id);
+        if (merge == nullptr) return;
+        queue.push_back(Candidate{merge->rank, pos, symbols[pos].id, symbols[next].id, merge->merged_id});
+        std::push_heap(queue.begin(), queue.end(), later);
+    };
     
-    // Sort added tokens by length (longest first) for proper matching
-    std::vector<std::string> sorted_tokens;
-    for (const auto& pair : added_tokens) {
-        sorted_tokens.push_back(pair.first);
+    for (int32_t pos = 0; pos + 1 < static_cast<int32_t>(symbols.size()); pos++) {
+        push_pair(pos);
     }
-    std::sort(sorted_tokens.begin(), sorted_tokens.end(),
-              [](const std::string& a, const std::string& b) {
-                  return a.length() > b.length();
-              });
     
-    // Split by each added token
-    for (const auto& token : sorted_tokens) {
-        std::vector<std::string> new_parts;
-        std::vector<bool> new_is_special;
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), later);
+        Candidate top = queue.back();
+        queue.pop_back();
         
-        for (size_t i = 0; i < parts.size(); i++) {
-            if (is_special[i]) {
-                // Already a special token, keep as-is
-                new_parts.push_back(parts[i]);
-                new_is_special.push_back(true);
-            } else {
-                // Split this part by the token
-                std::string part = parts[i];
-                size_t pos = 0;
-                size_t found = part.find(token, pos);
-                
-                if (found == std::string::npos) {
-                    // Token not found, keep part as-is
-                    new_parts.push_back(part);
-                    new_is_special.push_back(false);
-                } else {
-                    // Split by token
-                    while (found != std::string::npos) {
-                        // Add text before token
-                        if (found > pos) {
-                            new_parts.push_back(part.substr(pos, found - pos));
-                            new_is_special.push_back(false);
-                        }
-                        
-                        // Add the token itself
-                        new_parts.push_back(token);
-                        new_is_special.push_back(true);
-                        
-                        pos = found + token.length();
-                        found = part.find(token, pos);
-                    }
-                    
-                    // Add remaining text
-                    if (pos < part.length()) {
-                        new_parts.push_back(part.substr(pos));
-                        new_is_special.push_back(false);
-                    }
-                }
-            }
+        // Skip pairs invalidated by an earlier merge
+        Symbol& left = symbols[top.pos];
+        if (left.id != top.left || left.next < 0) continue;
+        Symbol& right = symbols[left.next];
+        if (right.id != top.right) continue;
+        
+        // Merge right into left and unlink it
+        left.id = top.merged_id;
+        right.id = -1;
+        left.next = right.next;
+        if (left.next >= 0) {
+            symbols[left.next].prev = top.pos;
         }
         
-        parts = new_parts;
-        is_special = new_is_special;
+        if (left.prev >= 0) push_pair(left.prev);
+        push_pair(top.pos);
     }
     
-    // Mark which indices are special tokens
-    std::vector<std::string> result;
-    for (size_t i = 0; i < parts.size(); i++) {
-        if (is_special[i]) {
-            result.push_back("\x01" + parts[i]); // Mark with special prefix
-        } else {
-            result.push_back(parts[i]);
-        }
+    for (int32_t pos = symbols.empty() ? -1 : 0; pos >= 0; pos = symbols[pos].next) {
+        int32_t id = symbols[pos].id;
+        output.push_back(id >= 0 ? id : unk_token_id);
     }
-    
-    return result;
 }
 
-std::vector<int64_t> BPETokenizer::encode(const std::string& text, 
-                                          bool add_special_tokens) {
-    // Clear cache for this encoding session
-    cache.clear();
-    
-    // Split by added tokens
-    auto text_parts = splitByAddedTokens(text);
+void BPETokenizer::encodeOrdinary(std::string_view text, std::vector<int64_t>& token_ids) const {
+    thread_local MergeScratch scratch;
     
-    std::vector<std::string> bpe_tokens;
+    // Apply GPT-2 pre-tokenization and BPE
+    PreTokenizer splitter(text);
+    std::string_view token;
     
-    // Process each part
-    for (const auto& part : text_parts) {
-        if (part.empty()) continue;
+    while (splitter.next(token)) {
+        if (cache->lookup(token, token_ids)) continue;
         
-        // Check if this is a special token (marked with \x01)
-        if (part[0] == '\x01') {
-            // This is an added token
-            std::string token = part.substr(1);
-            bpe_tokens.push_back(token);
-        } else {
-            // Normal text - apply regex splitting and BPE
-            std::sregex_iterator iter(part.begin(), part.end(), pattern);
-            std::sregex_iterator end;
-            
-            for (; iter != end; ++iter) {
-                std::string token = iter->str();
-                
-                // Convert to byte-level representation
-                std::string token_bytes;
-                for (unsigned char c : token) {
-                    auto it = byte_encoder.find(c);
-                    if (it != byte_encoder.end()) {
-                        std::u32string u32str(1, it->second);
-                        token_bytes += utf32ToUtf8(u32str);
-                    }
-                }
-                
-                // Apply BPE
-                std::string bpe_output = bpe(token_bytes);
-                
-                // Split by spaces and add tokens
-                std::istringstream iss(bpe_output);
-                std::string subtoken;
-                while (iss >> subtoken) {
-                    bpe_tokens.push_back(subtoken);
-                }
-            }
-        }
+        // Apply BPE
+        size_t first = token_ids.size();
+        bpe(token, scratch, token_ids);
+        cache->insert(token, token_ids.data() + first, token_ids.size() - first);
     }
-    
-    // Convert tokens to IDs
+}
+
+std::vector<int64_t> BPETokenizer::encode(const std::string& text, 
+                                          bool add_special_tokens) const {
     std::vector<int64_t> token_ids;
-    for (const auto& token : bpe_tokens) {
-        auto it = vocab.find(token);
-        if (it != vocab.end()) {
-            token_ids.push_back(it->second);
-        } else {
-            token_ids.push_back(unk_token_id);
-        }
+    encodeInto(text, add_special_tokens, token_ids);
+    return token_ids;
+}
+
+void BPETokenizer::encodeInto(std::string_view text, bool add_special_tokens,
+                              std::vector<int64_t>& token_ids) const {
+    // Added tokens map straight to their IDs, the text between them goes through BPE
+    size_t pos = 0;
+    AddedTokenMatcher::Match match;
+    while (added_matcher.findNext(text, pos, match)) {
+        encodeOrdinary(text.substr(pos, match.begin - pos), token_ids);
+        token_ids.push_back(match.id);
+        pos = match.end;
     }
+    encodeOrdinary(text.substr(pos), token_ids);
     
     // Add special tokens (2x EOS at end)
     if (add_special_tokens) {
         token_ids.push_back(eos_token_id);
         token_ids.push_back(eos_token_id);
     }
-    
-    return token_ids;
 }
 
-std::string BPETokenizer::decode(const std::vector<int64_t>& token_ids,
-                                 bool skip_special_tokens) const {
-    // Convert IDs to tokens
-    std::vector<std::string> tokens;
-    for (int64_t id : token_ids) {
-        if (skip_special_tokens && id == eos_token_id) {
-            continue;
+EncodedBatch BPETokenizer::encodeBatch(const std::string_view* texts, size_t count,
+                                       bool add_special_tokens) const {
+    // Runs of consecutive texts are encoded into chunk-local buffers, which
+    // are copied into place once all sizes are known
+    const size_t chunk_size = 32;
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    std::vector<EncodedBatch> chunks(chunk_count);
+    
+    auto run = [&](size_t tasks, const std::function<void(size_t)>& task) {
+        if (pool && tasks > 1) {
+            pool->parallelFor(tasks, task);
+        } else {
+            for (size_t i = 0; i < tasks; i++) task(i);
         }
-        
-        auto it = id_to_token.find(id);
-        if (it != id_to_token.end()) {
-            tokens.push_back(it->second);
+    };
+    
+    run(chunk_count, [&](size_t c) {
+        EncodedBatch& chunk = chunks[c];
+        size_t first = c * chunk_size;
+        size_t last = std::min(count, first + chunk_size);
+        chunk.offsets.reserve(last - first + 1);
+        chunk.offsets.push_back(0);
+        for (size_t i = first; i < last; i++) {
+            encodeInto(texts[i], add_special_tokens, chunk.ids);
+            chunk.offsets.push_back(chunk.ids.size());
         }
+    });
+    
+    std::vector<size_t> chunk_start(chunk_count + 1, 0);
+    for (size_t c = 0; c < chunk_count; c++) {
+        chunk_start[c + 1] = chunk_start[c] + chunks[c].ids.size();
     }
     
-    // Join tokens
-    std::string text;
-    for (const auto& token : tokens) {
-        text += token;
+    EncodedBatch batch;
+    batch.ids.resize(chunk_start[chunk_count]);
+    batch.offsets.resize(count + 1);
+    batch.offsets[0] = 0;
+    run(chunk_count, [&](size_t c) {
+        const EncodedBatch& chunk = chunks[c];
+        std::copy(chunk.ids.begin(), chunk.ids.end(), batch.ids.begin() + chunk_start[c]);
+        for (size_t i = 1; i < chunk.offsets.size(); i++) {
+            batch.offsets[c * chunk_size + i] = chunk_start[c] + chunk.offsets[i];
+        }
+    });
+    return batch;
+}
+
+EncodedBatch BPETokenizer::encodeBatch(const std::vector<std::string>& texts,
+                                       bool add_special_tokens) const {
+    std::vector<std::string_view> views(texts.begin(), texts.end());
+    return encodeBatch(views.data(), views.size(), add_special_tokens);
+}
+
+void BPETokenizer::setCacheCapacity(size_t entries) {
+    cache->setCapacity(entries);
+}
+
+bool BPETokenizer::setSharedCache(std::shared_ptr<ShardedBPEWordCache> shared) {
+    if (!shared) {
+        cache = std::make_shared<ShardedBPEWordCache>();
+        cache->bind(tables);
+        return true;
+    }
+    if (!shared->bind(tables)) {
+        std::cerr << "Error: BPE cache is shared with a tokenizer of another vocabulary" << std::endl;
+        return false;
+    }
+    cache = std::move(shared);
+    return true;
+}
+
+BPEWordCache::Stats BPETokenizer::cacheStats() const {
+    return cache->stats();
+}
+
+void BPETokenizer::setThreadCount(size_t threads) {
+    pool = threads == 1 ? nullptr : std::make_shared<ThreadPool>(threads);
+}
+
+std::string BPETokenizer::decode(const std::vector<int64_t>& token_ids,
+                                 bool skip_special_tokens) const {
+    std::string result;
+    if (!tables) {
+        return result;
     }
     
-    // Decode from byte-level representation
-    std::u32string u32text = utf8ToUtf32(text);
-    std::vector<uint8_t> byte_array;
+    size_t length = 0;
+    for (int64_t id : token_ids) {
+        length += tables->tokenBytes(id).size();
+    }
+    result.reserve(length);
     
-    for (char32_t c : u32text) {
-        auto it = byte_decoder.find(c);
-        if (it != byte_decoder.end()) {
-            byte_array.push_back(it->second);
+    for (int64_t id : token_ids) {
+        if (skip_special_tokens && id == eos_token_id) {
+            continue;
         }
+        result += tables->tokenBytes(id);
     }
     
-    // Convert bytes to string
-    std::string result(byte_array.begin(), byte_array.end());
-    
     return result;
 }
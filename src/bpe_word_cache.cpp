@@ -0,0 +1,164 @@
+#include "bpe_word_cache.hpp"
+#include <functional>
+
+BPEWordCache::Stats& BPEWordCache::Stats::operator+=(const Stats& other) {
+    hits += other.hits;
+    misses += other.misses;
+    insertions += other.insertions;
+    evictions += other.evictions;
+    size += other.size;
+    capacity += other.capacity;
+    return *this;
+}
+
+BPEWordCache::BPEWordCache(size_t capacity) : max_entries(0) {
+    setCapacity(capacity);
+}
+
+bool BPEWordCache::lookup(std::string_view piece, std::vector<int64_t>& output) {
+    auto it = index.find(piece);
+    if (it == index.end()) {
+        counters.misses++;
+        return false;
+    }
+
+    Entry& entry = entries[it->second];
+    entry.referenced = true;
+    output.insert(output.end(), entry.ids.begin(), entry.ids.end());
+    counters.hits++;
+    return true;
+}
+
+void BPEWordCache::insert(std::string_view piece, const int64_t* ids, size_t count) {
+    if (max_entries == 0 || piece.size() > MAX_KEY_LENGTH || index.count(piece) != 0) {
+        return;
+    }
+
+    uint32_t slot;
+    if (entries.size() < max_entries) {
+        // entries never grows past the reserved capacity, so keys do not move
+        slot = static_cast<uint32_t>(entries.size());
+        entries.emplace_back();
+    } else {
+        // Sweep the clock hand to the first entry not referenced since the last pass
+        while (entries[hand].referenced) {
+            entries[hand].referenced = false;
+            hand = (hand + 1) % entries.size();
+        }
+        slot = static_cast<uint32_t>(hand);
+        hand = (hand + 1) % entries.size();
+        index.erase(entries[slot].key);
+        counters.evictions++;
+    }
+
+    Entry& entry = entries[slot];
+    entry.key.assign(piece.data(), piece.size());
+    entry.ids.assign(ids, ids + count);
+    entry.referenced = false;
+    index.emplace(entry.key, slot);
+    counters.insertions++;
+}
+
+void BPEWordCache::setCapacity(size_t capacity) {
+    clear();
+    max_entries = capacity;
+    entries.shrink_to_fit();
+    entries.reserve(capacity);
+    index.reserve(capacity);
+}
+
+void BPEWordCache::clear() {
+    index.clear();
+    entries.clear();
+    hand = 0;
+}
+
+void BPEWordCache::resetStats() {
+    counters = Stats();
+}
+
+BPEWordCache::Stats BPEWordCache::stats() const {
+    Stats result = counters;
+    result.size = index.size();
+    result.capacity = max_entries;
+    return result;
+}
+
+ShardedBPEWordCache::ShardedBPEWordCache(size_t capacity, size_t shards) {
+    shard_count = 1;
+    while (shard_count < shards) {
+        shard_count <<= 1;
+    }
+    this->shards.reset(new Shard[shard_count]);
+    setCapacity(capacity);
+}
+
+ShardedBPEWordCache::Shard& ShardedBPEWordCache::shardFor(std::string_view piece) {
+    size_t hash = std::hash<std::string_view>()(piece);
+    // Mix the high bits in; the shard's own map uses the low bits
+    return shards[(hash ^ (hash >> 29)) & (shard_count - 1)];
+}
+
+bool ShardedBPEWordCache::lookup(std::string_view piece, std::vector<int64_t>& output) {
+    Shard& shard = shardFor(piece);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache.lookup(piece, output);
+}
+
+void ShardedBPEWordCache::insert(std::string_view piece, const int64_t* ids, size_t count) {
+    Shard& shard = shardFor(piece);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.cache.insert(piece, ids, count);
+}
+
+void ShardedBPEWordCache::setCapacity(size_t capacity) {
+    for (size_t i = 0; i < shard_count; i++) {
+        // Spread the remainder over the first shards
+        size_t share = capacity / shard_count + (i < capacity % shard_count ? 1 : 0);
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].cache.setCapacity(share);
+    }
+}
+
+void ShardedBPEWordCache::clear() {
+    for (size_t i = 0; i < shard_count; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].cache.clear();
+    }
+}
+
+void ShardedBPEWordCache::resetStats() {
+    for (size_t i = 0; i < shard_count; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].cache.resetStats();
+    }
+}
+
+bool ShardedBPEWordCache::bind(const std::shared_ptr<const TokenizerTables>& tables) {
+    std::lock_guard<std::mutex> lock(binding_mutex);
+    std::shared_ptr<const TokenizerTables> current = bound_tables.lock();
+    if (current == tables) {
+        return true;
+    }
+    if (current) {
+        return false;
+    }
+    clear();
+    bound_tables = tables;
+    return true;
+}
+
+void ShardedBPEWordCache::rebind(const std::shared_ptr<const TokenizerTables>& tables) {
+    std::lock_guard<std::mutex> lock(binding_mutex);
+    clear();
+    bound_tables = tables;
+}
+
+BPEWordCache::Stats ShardedBPEWordCache::stats() const {
+    BPEWordCache::Stats total;
+    for (size_t i = 0; i < shard_count; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        total += shards[i].cache.stats();
+    }
+    return total;
+}
@@ -1,51 +1,126 @@
 #include "chatterbox.h"
+#include "bpe_tokenizer.hpp"
+#include "model_registry.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <thread>
+
+namespace {
+
+// Tokens handed from the generation thread to the vocoder thread
+struct TokenBatch {
+    std::vector<int64_t> tokens;
+    bool isFinal = false;
+};
+
+// Spin briefly, then sleep, while the other pipeline stage catches up
+void backoff(int& spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+// Size of the last dimension of a session output, or fallback if the model
+// leaves it dynamic
+int64_t outputWidth(const Ort::Session& session, size_t index, int64_t fallback) {
+    std::vector<int64_t> shape = session.GetOutputTypeInfo(index).GetTensorTypeAndShapeInfo().GetShape();
+    return !shape.empty() && shape.back() > 0 ? shape.back() : fallback;
+}
+
+} // namespace
 
 ChatterBox::ChatterBox(const std::string modelDir, bool useCuda)
-    : env_(nullptr),
-      sessionOptions_(),
-      conditionalDecoder(nullptr),
-      embedTokens(nullptr),
-      languageModel(nullptr) {
-    
-    env_ = Ort::Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "Chatterbox-turbo");
-    env_.DisableTelemetryEvents();                       
-
-    if (useCuda) {
-        // Use CUDA provider
-        OrtCUDAProviderOptions cuda_options{};
-        cuda_options.cudnn_conv_algo_search = OrtCudnnConvAlgoSearchHeuristic;
-        sessionOptions_.AppendExecutionProvider_CUDA(cuda_options);
+    : ChatterBox(modelDir, [useCuda]() {
+          ChatterBoxConfig config;
+          config.useCuda = useCuda;
+          return config;
+      }()) {}
+
+ChatterBox::ChatterBox(const std::string modelDir, const ChatterBoxConfig& config)
+    : repetitionPenalty(config.repetitionPenalty),
+      useEmbeddingTable(config.useEmbeddingTable),
+      maxContextLength(config.maxContextLength),
+      metricsLogPath(config.metricsLog),
+      languageModelBinding(nullptr),
+      sampler(createSampler(config.sampling)) {
+
+    // Sessions are shared with every other instance using the same models and options
+    ModelRegistry& registry = ModelRegistry::instance();
+    conditionalDecoder = registry.getSession(modelDir + "/conditional_decoder.onnx",
+        config.conditionalDecoder, config.useCuda, config.optimizedModelCacheDir);
+    embedTokens = registry.getSession(modelDir + "/embed_tokens.onnx",
+        config.embedTokens, config.useCuda, config.optimizedModelCacheDir);
+    languageModel = registry.getSession(modelDir + "/language_model.onnx",
+        config.languageModel, config.useCuda, config.optimizedModelCacheDir);
+    languageModelBinding = Ort::IoBinding(*languageModel);
+
+    // Logits [batch, seq, vocab]: exported models may pad the speech vocabulary
+    logitsVocabSize = outputWidth(*languageModel, 0, SPEECH_VOCAB_SIZE);
+    decodeContext = DecodeContext(HIDDEN_SIZE, logitsVocabSize);
+    logitsProcessor = LogitsProcessor(1.0f, logitsVocabSize);
+
+    if (useEmbeddingTable) {
+        speechEmbeddingTable = registry.getTable(modelDir + "/embed_tokens.onnx#speech",
+            [this]() { return buildSpeechEmbeddingTable(); });
     }
-    sessionOptions_.SetGraphOptimizationLevel(
-        GraphOptimizationLevel::ORT_DISABLE_ALL);
-
-    sessionOptions_.DisableCpuMemArena();
-    sessionOptions_.DisableMemPattern();
-    sessionOptions_.DisableProfiling();
-
-    std::string conditionalDecoderPathString = modelDir + "/conditional_decoder.onnx";
-    std::string embedTokensPathString = modelDir + "/embed_tokens.onnx";
-    std::string languageModelPathString = modelDir + "/language_model.onnx";
-    #ifdef _WIN32
-    std::wstring conditionalDecoderPath_wstr = std::wstring(conditionalDecoderPathString.begin(), conditionalDecoderPathString.end());
-    std::wstring embedTokensPath_wstr = std::wstring(embedTokensPathString.begin(), embedTokensPathString.end());
-    std::wstring languageModelPath_wstr = std::wstring(languageModelPathString.begin(), languageModelPathString.end());
-    auto conditionalDecoderPath = conditionalDecoderPath_wstr.c_str();
-    auto embedTokensPath = embedTokensPath_wstr.c_str();
-    auto languageModelPath = languageModelPath_wstr.c_str();
-    #else
-    auto conditionalDecoderPath = conditionalDecoderPathString.c_str();
-    auto embedTokensPath = embedTokensPathString.c_str();
-    auto languageModelPath = languageModelPathString.c_str();
-    #endif
-
-    conditionalDecoder = Ort::Session(env_, conditionalDecoderPath, sessionOptions_);
-    embedTokens = Ort::Session(env_, embedTokensPath, sessionOptions_);
-    languageModel = Ort::Session(env_, languageModelPath, sessionOptions_);
 }
 
 ChatterBox::~ChatterBox() {}
 
+void ChatterBox::setSampler(std::unique_ptr<Sampler> newSampler) {
+    sampler = newSampler ? std::move(newSampler) : std::make_unique<GreedySampler>();
+}
+
+ChatterBox::MetricsScope::MetricsScope(ChatterBox& owner) : owner(owner) {
+    if (owner.requestDepth++ == 0) {
+        owner.metrics = SynthesisMetrics();
+        owner.requestStart = MetricsClock::now();
+    }
+}
+
+ChatterBox::MetricsScope::~MetricsScope() {
+    if (--owner.requestDepth == 0) {
+        owner.metrics.finish(owner.msSince(owner.requestStart));
+        if (!owner.metricsLogPath.empty() && !appendMetricsLine(owner.metricsLogPath, owner.metrics)) {
+            std::cerr << "Cannot write metrics to " << owner.metricsLogPath << std::endl;
+        }
+    }
+}
+
+double ChatterBox::msSince(MetricsClock::time_point start) const {
+    return std::chrono::duration<double, std::milli>(MetricsClock::now() - start).count();
+}
+
+SynthesisResult ChatterBox::synthesize(std::vector<int64_t> inputIds) {
+    SynthesisResult result;
+    {
+        MetricsScope metricsScope(*this);
+        result.speechTokens = SynthesizeSpeechTokens(std::move(inputIds));
+        result.pcm = synthesizeSpeech(result.speechTokens);
+    }
+    result.metrics = metrics;
+    return result;
+}
+
+SynthesisResult ChatterBox::synthesize(const BPETokenizer& tokenizer, const std::string& text) {
+    SynthesisResult result;
+    {
+        MetricsScope metricsScope(*this);
+        auto start = MetricsClock::now();
+        std::vector<int64_t> inputIds = tokenizer.encode(text, true);
+        metrics.tokenizeMs = msSince(start);
+
+        result.speechTokens = SynthesizeSpeechTokens(std::move(inputIds));
+        result.pcm = synthesizeSpeech(result.speechTokens);
+    }
+    result.metrics = metrics;
+    return result;
+}
+
 void ChatterBox::LoadStyle(std::string styleDir) {
     std::string condEmbPath = styleDir + "/cond_emb.bin";
     condEmb = LoadBinaryFile(condEmbPath);
@@ -58,6 +133,8 @@ void ChatterBox::LoadStyle(std::string styleDir) {
 
     std::string speakerFeaturesPath = styleDir + "/speaker_features.bin";
     speakerFeatures = LoadBinaryFile(speakerFeaturesPath);
+
+    prefillConditioning();
 }
 
 std::vector<float> ChatterBox::LoadBinaryFile(std::string filename){
@@ -102,166 +179,231 @@ std::vector<int64_t> ChatterBox::LoadBinaryFileInt64(std::string filename) {
 }
 
 std::vector<int64_t> ChatterBox::SynthesizeSpeechTokens(std::vector<int64_t> inputIds) {
+    return SynthesizeSpeechTokens(std::move(inputIds), nullptr);
+}
+
+std::vector<int64_t> ChatterBox::SynthesizeSpeechTokens(std::vector<int64_t> inputIds,
+                                                        const SpeechTokenCallback& callback,
+                                                        int callbackInterval) {
+    MetricsScope metricsScope(*this);
+    decodeStepMs.clear();
+    decodeStepMs.reserve(static_cast<size_t>(MAX_SPEECH_TOKENS));
+
+    // ORT allocations of this request come from the instance's language model arena
+    languageModelArena.reset();
+    RequestArenaScope arenaScope(languageModelArena);
+
     std::vector<int64_t> generatedTokens;
+    std::vector<int64_t> pendingTokens;
+    generatedTokens.reserve(static_cast<size_t>(MAX_SPEECH_TOKENS) + 1);
+    pendingTokens.reserve(static_cast<size_t>(std::max(callbackInterval, 1)));
+    bool cancelled = false;
     generatedTokens.push_back(START_SPEECH_TOKEN);
+    logitsProcessor.setRepetitionPenalty(repetitionPenalty);
+    logitsProcessor.reset();
+    logitsProcessor.observe(START_SPEECH_TOKEN);
+    sampler->reset();
 
-    std::vector<int64_t> embedTokensInputsDim{1, static_cast<int64_t>(inputIds.size())};
-    std::vector<Ort::Value> embedTokensInputTensors;
-    embedTokensInputTensors.push_back(Ort::Value::CreateTensor<int64_t>(
-            memoryInfo, inputIds.data(), inputIds.size(),
-            embedTokensInputsDim.data(), embedTokensInputsDim.size()));
-    int64_t condEmbLength = int64_t(condEmb.size() / 1024);
-    int64_t currentSeqLen = static_cast<int64_t>(inputIds.size()) + condEmbLength;
-    int64_t currentPosition = currentSeqLen - 1; 
-
-    std::vector<Ort::Value> languageModelInputTensors;
-    std::vector<Ort::Value> pastKeyValues; 
+    int64_t currentSeqLen = static_cast<int64_t>(inputIds.size()) + condPrefixLength;
     
+    // Brackets one phase of a decode step, everything but the language model run
+    auto probeStep = [this](int step, DecodeStepPhase phase, bool active) {
+        if (decodeStepProbe && step > 0) {
+            decodeStepProbe(phase, active);
+        }
+    };
+
     int64_t nextTokenId = 0;
-    for (int i = 0; i < 1024; i++) {
-        std::vector<float> currentEmbedsData;
-        std::vector<int64_t> currentEmbedsShape;
+    for (int i = 0; i < MAX_SPEECH_TOKENS; i++) {
+        auto stepStart = MetricsClock::now();
+        float* lastTokenLogits = nullptr;
 
         if (i == 0) {
-            // Get embedding from input text
-            std::vector<int64_t> embedTokensInputsDim{1, static_cast<int64_t>(inputIds.size())};
-            Ort::Value embedTokensInput = Ort::Value::CreateTensor<int64_t>(
-                memoryInfo, inputIds.data(), inputIds.size(),
-                embedTokensInputsDim.data(), embedTokensInputsDim.size());
-            
-            auto inputsEmbedsOutput = embedTokens.Run(Ort::RunOptions{nullptr}, 
-                embedTokensInputNames.data(), &embedTokensInput, 1, 
-                bertEncoderOutputNames.data(), bertEncoderOutputNames.size());
-
-            const float* promptEmbedsData = inputsEmbedsOutput.front().GetTensorData<float>();
-            size_t promptEmbedsSize = inputsEmbedsOutput.front().GetTensorTypeAndShapeInfo().GetElementCount();
-
-            currentEmbedsData = condEmb;
-            currentEmbedsData.insert(currentEmbedsData.end(), promptEmbedsData, promptEmbedsData + promptEmbedsSize);
-            
-            currentEmbedsShape = {1, static_cast<int64_t>(inputIds.size()) + condEmbLength, 1024};
-
+            lastTokenLogits = prefillText(inputIds);
         } 
         else {
-            // Get embedding for the next generated token            
-            std::vector<int64_t> nextInputIdVec = {nextTokenId};
-            std::vector<int64_t> embedTokensInputsDim{1, 1}; // Batch 1, Seq 1
-            
-            Ort::Value embedTokensInput = Ort::Value::CreateTensor<int64_t>(
-                memoryInfo, nextInputIdVec.data(), nextInputIdVec.size(),
-                embedTokensInputsDim.data(), embedTokensInputsDim.size());
-
-            auto inputsEmbedsOutput = embedTokens.Run(Ort::RunOptions{nullptr}, 
-                embedTokensInputNames.data(), &embedTokensInput, 1, 
-                bertEncoderOutputNames.data(), bertEncoderOutputNames.size());
-            
-            const float* newEmbedData = inputsEmbedsOutput.front().GetTensorData<float>();
-            size_t newEmbedSize = inputsEmbedsOutput.front().GetTensorTypeAndShapeInfo().GetElementCount();
-
-            currentEmbedsData.assign(newEmbedData, newEmbedData + newEmbedSize);
-            currentEmbedsShape = {1, 1, 1024}; // Each iteration just generated one token
+            if (currentSeqLen > kvCache.capacity()) {
+                std::cerr << "\nKV cache full at step " << i << ", increase maxContextLength" << std::endl;
+                break;
+            }
+
+            // Get embedding for the next generated token, each iteration just generated one
+            probeStep(i, DecodeStepPhase::Host, true);
+            decodeContext.prepare(1, kvCache.length(), 1);
+            embedSpeechToken(nextTokenId, decodeContext.embeds());
+            probeStep(i, DecodeStepPhase::Host, false);
+
+            probeStep(i, DecodeStepPhase::Binding, true);
+            bindLanguageModel(decodeContext.embeds());
+            probeStep(i, DecodeStepPhase::Binding, false);
+            lastTokenLogits = runBoundLanguageModel();
         }
 
-        // prepare inputs for language model
-        languageModelInputTensors.clear();
-
-        // Input 0: inputs_embeds
-        languageModelInputTensors.push_back(Ort::Value::CreateTensor<float>(
-            memoryInfo, currentEmbedsData.data(), currentEmbedsData.size(),
-            currentEmbedsShape.data(), currentEmbedsShape.size()));
-
-        // Input 1: attention_mask
-        std::vector<int64_t> currentMask(currentSeqLen, 1);
-        std::vector<int64_t> currentMaskShape{1, currentSeqLen};
-        languageModelInputTensors.push_back(Ort::Value::CreateTensor<int64_t>(
-            memoryInfo, currentMask.data(), currentMask.size(),
-            currentMaskShape.data(), currentMaskShape.size()));
-
-        // Input 2: position_ids
-        std::vector<int64_t> currentPosIds;
-        std::vector<int64_t> currentPosIdsShape;
-        
+        probeStep(i, DecodeStepPhase::Host, true);
+        nextTokenId = selectNextToken(lastTokenLogits, decodeContext.vocabSize(), logitsProcessor, *sampler);
         if (i == 0) {
-            // i=0: 0, 1, 2, ..., seqLen-1
-            currentPosIds.resize(currentSeqLen);
-            for(int k=0; k<currentSeqLen; ++k) currentPosIds[k] = k;
-            currentPosIdsShape = {1, currentSeqLen};
+            metrics.prefillMs = msSince(stepStart);
+            metrics.timeToFirstTokenMs = msSince(requestStart);
         } else {
-            currentPosition++;
-            currentPosIds.push_back(currentPosition);
-            currentPosIdsShape = {1, 1};
+            decodeStepMs.push_back(msSince(stepStart));
         }
-        languageModelInputTensors.push_back(Ort::Value::CreateTensor<int64_t>(
-            memoryInfo, currentPosIds.data(), currentPosIds.size(),
-            currentPosIdsShape.data(), currentPosIdsShape.size()));
-
-        // Input 3..50: past_key_values
-        if (i == 0) {
-            // At first iteration, past KV is setted to zeros
-            for (int j = 0; j < 48; j++) {
-                std::vector<int64_t> pastShape = {1, 16, 0, 64};
-                std::vector<float> pastData(0.0); 
-                pastKeyValues.push_back(Ort::Value::CreateTensor<float>(
-                    memoryInfo, pastData.data(), pastData.size(),
-                    pastShape.data(), pastShape.size()));
-            }
+        bool stopped = nextTokenId == STOP_SPEECH_TOKEN;
+        if (!stopped) {
+            generatedTokens.push_back(nextTokenId);
+            currentSeqLen++;
         }
-        
-        // Push KV Cache into input list
-        for (auto& kv : pastKeyValues) {
-            languageModelInputTensors.push_back(std::move(kv)); // Move to avoid copy
+        probeStep(i, DecodeStepPhase::Host, false);
+        if (stopped) {
+            std::cout << "\nStop token reached at step " << i << std::endl;
+            break;
         }
 
-        // Run language model
-        auto languageModelOutput = languageModel.Run(Ort::RunOptions{nullptr},
-            languageModelInputNames.data(), languageModelInputTensors.data(), languageModelInputTensors.size(),
-            languageModelOutputNames.data(), languageModelOutputNames.size());
-
-        // Output 0: Logits [Batch, Seq, Vocab]
-        float* logitsRaw = languageModelOutput[0].GetTensorMutableData<float>();
-        auto logitsShape = languageModelOutput[0].GetTensorTypeAndShapeInfo().GetShape();
-        int64_t vocabSize = logitsShape[2];
-        int64_t seqDim = logitsShape[1];
-        
-        float* lastTokenLogits = logitsRaw + 1*(seqDim-1) * vocabSize;
-
-        applyRepetitionPenalty(lastTokenLogits, vocabSize, generatedTokens, repetitionPenalty);
-        // ----------------------------------
-
-        // Greedy Search (Argmax) - Find the token with the highest score after penalty
-        int64_t bestTokenId = 0;
-        float maxScore = -std::numeric_limits<float>::infinity();
-
-        for (int64_t v = 0; v < vocabSize; v++) {
-            if (lastTokenLogits[v] > maxScore) {
-                maxScore = lastTokenLogits[v];
-                bestTokenId = v;
+        if (callback) {
+            pendingTokens.push_back(nextTokenId);
+            if (static_cast<int>(pendingTokens.size()) >= callbackInterval) {
+                cancelled = !callback(pendingTokens, false);
+                pendingTokens.clear();
+                if (cancelled) {
+                    break;
+                }
             }
         }
+    }
 
-        nextTokenId = bestTokenId;
-        if (nextTokenId == STOP_SPEECH_TOKEN) {
-            std::cout << "\nStop token reached at step " << i << std::endl;
-            break;
+    metrics.speechTokens = static_cast<int64_t>(generatedTokens.size()) - 1;
+    metrics.setDecodeSteps(decodeStepMs);
+
+    if (callback && !cancelled) {
+        callback(pendingTokens, true);
+    }
+    return generatedTokens;
+}
+
+std::vector<int16_t> ChatterBox::synthesizeSpeech(std::vector<int64_t> generatedTokens) {
+    MetricsScope metricsScope(*this);
+    vocoderArena.reset();
+    std::vector<int64_t> tokens(generatedTokens.begin()+1, generatedTokens.end());
+    std::vector<float> audio = decodeWaveform(tokens, true);
+    return convertToPcm16(audio);
+}
+
+std::vector<int64_t> ChatterBox::synthesizeSpeechStreaming(std::vector<int64_t> inputIds,
+                                                           const AudioCallback& onAudio,
+                                                           const StreamingOptions& options) {
+    MetricsScope metricsScope(*this);
+    vocoderArena.reset();
+    if (options.pipelined) {
+        return synthesizeSpeechPipelined(std::move(inputIds), onAudio, options);
+    }
+
+    StreamingVocoder vocoder(options,
+        [this](const std::vector<int64_t>& tokens, bool isFinal) {
+            return decodeWaveform(tokens, isFinal);
+        },
+        [this, &onAudio](const std::vector<float>& samples, bool isFinal) {
+            return onAudio(convertToPcm16(samples), isFinal);
+        });
+
+    return SynthesizeSpeechTokens(std::move(inputIds),
+        [&vocoder](const std::vector<int64_t>& newTokens, bool isFinal) {
+            vocoder.push(newTokens);
+            if (isFinal) {
+                vocoder.finish();
+            }
+            return !vocoder.cancelled();
+        });
+}
+
+std::vector<int64_t> ChatterBox::synthesizeSpeechPipelined(std::vector<int64_t> inputIds,
+                                                           const AudioCallback& onAudio,
+                                                           const StreamingOptions& options) {
+    SpscQueue<TokenBatch> queue(static_cast<size_t>(std::max(options.queueCapacity, 1)));
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> producerDone{false};
+    std::vector<int64_t> generatedTokens;
+    std::exception_ptr producerError;
+
+    // Producer: the language model runs on its own thread
+    std::thread producer([&]() {
+        try {
+            generatedTokens = SynthesizeSpeechTokens(std::move(inputIds),
+                [&](const std::vector<int64_t>& newTokens, bool isFinal) {
+                    TokenBatch batch{newTokens, isFinal};
+                    int spins = 0;
+                    while (!queue.tryPush(batch)) {
+                        if (stopRequested.load(std::memory_order_relaxed)) {
+                            return false;
+                        }
+                        backoff(spins);
+                    }
+                    return !stopRequested.load(std::memory_order_relaxed);
+                });
+        } catch (...) {
+            producerError = std::current_exception();
         }
-        generatedTokens.push_back(nextTokenId);
-        
-        // Update KV Cache for next iteration
-        pastKeyValues.clear(); // Clear old
-        for (size_t k = 1; k < languageModelOutput.size(); k++) {
-            pastKeyValues.push_back(std::move(languageModelOutput[k]));
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    // Consumer: the conditional decoder runs on the calling thread
+    StreamingVocoder vocoder(options,
+        [this](const std::vector<int64_t>& tokens, bool isFinal) {
+            return decodeWaveform(tokens, isFinal);
+        },
+        [this, &onAudio](const std::vector<float>& samples, bool isFinal) {
+            return onAudio(convertToPcm16(samples), isFinal);
+        });
+
+    std::exception_ptr consumerError;
+    try {
+        TokenBatch batch;
+        int spins = 0;
+        while (true) {
+            if (!queue.tryPop(batch)) {
+                if (!producerDone.load(std::memory_order_acquire)) {
+                    backoff(spins);
+                    continue;
+                }
+                // Generation has ended, drain the last batch it pushed
+                if (!queue.tryPop(batch)) {
+                    break;
+                }
+            }
+            spins = 0;
+            vocoder.push(batch.tokens);
+            if (batch.isFinal) {
+                vocoder.finish();
+            }
+            if (batch.isFinal || vocoder.cancelled()) {
+                break;
+            }
         }
-        currentSeqLen++;
+    } catch (...) {
+        consumerError = std::current_exception();
+    }
+
+    stopRequested.store(true, std::memory_order_relaxed);
+    producer.join();
+
+    if (producerError) {
+        std::rethrow_exception(producerError);
+    }
+    if (consumerError) {
+        std::rethrow_exception(consumerError);
     }
     return generatedTokens;
 }
 
-std::vector<int16_t> ChatterBox::synthesizeSpeech(std::vector<int64_t> generatedTokens) {
+std::vector<float> ChatterBox::decodeWaveform(const std::vector<int64_t>& tokens, bool appendSilence) {
+    RequestArenaScope arenaScope(vocoderArena);
+    auto start = MetricsClock::now();
+
     // Run audio decoder model
     std::vector<int64_t> speechTokens;
     speechTokens.insert(speechTokens.end(), promptToken.begin(), promptToken.end());    
-    speechTokens.insert(speechTokens.end(), generatedTokens.begin()+1, generatedTokens.end());
-    speechTokens.insert(speechTokens.end(), {4299, 4299, 4299}); // Add silence at the end
+    speechTokens.insert(speechTokens.end(), tokens.begin(), tokens.end());
+    if (appendSilence) {
+        speechTokens.insert(speechTokens.end(), {4299, 4299, 4299}); // Add silence at the end
+    }
     std::vector<Ort::Value> conditionalDecoderInputTensors;
     std::vector<int64_t> speechTokensDim{1, static_cast<int64_t>(speechTokens.size())};
     conditionalDecoderInputTensors.push_back(Ort::Value::CreateTensor<int64_t>(
@@ -275,43 +417,170 @@ std::vector<int16_t> ChatterBox::synthesizeSpeech(std::vector<int64_t> generated
     conditionalDecoderInputTensors.push_back(Ort::Value::CreateTensor<float>(
         memoryInfo, speakerFeatures.data(), speakerFeatures.size(),
         speakerFeaturesDim.data(), speakerFeaturesDim.size()));
-    auto audioOutput = conditionalDecoder.Run(
+    auto audioOutput = conditionalDecoder->Run(
         Ort::RunOptions{nullptr},
         conditionalDecoderInputNames.data(), conditionalDecoderInputTensors.data(), conditionalDecoderInputTensors.size(),
         conditionalDecoderOutputNames.data(), conditionalDecoderOutputNames.size());
     
-    std::vector<int16_t> audioBuffer;
     const float *audioOutputData = audioOutput.front().GetTensorData<float>();
-
     std::vector<int64_t> audioOutputShape = audioOutput.front().GetTensorTypeAndShapeInfo().GetShape();
     int64_t audioOutputCount = audioOutputShape[audioOutputShape.size() - 1];
-    audioBuffer.reserve(audioOutputCount);
+    std::vector<float> audio(audioOutputData, audioOutputData + audioOutputCount);
+    metrics.vocoderMs += msSince(start);
+    return audio;
+}
+
+std::vector<int16_t> ChatterBox::convertToPcm16(const std::vector<float>& audio) {
+    auto start = MetricsClock::now();
+    std::vector<int16_t> audioBuffer;
+    audioBuffer.reserve(audio.size());
 
     // Convert float audio to int16
-    for (int64_t i = 0; i < audioOutputCount; i++) {
+    for (float sample : audio) {
         int16_t intAudioValue = static_cast<int16_t>(
-            std::clamp(audioOutputData[i] * MAX_WAV_VALUE,
+            std::clamp(sample * MAX_WAV_VALUE,
                         static_cast<float>(std::numeric_limits<int16_t>::min()),
                         static_cast<float>(std::numeric_limits<int16_t>::max())));
         audioBuffer.push_back(intAudioValue);
     }
+
+    metrics.pcmMs += msSince(start);
+    metrics.audioSeconds += static_cast<double>(audio.size()) / SAMPLE_RATE;
+    if (metrics.timeToFirstAudioMs == 0.0) {
+        metrics.timeToFirstAudioMs = msSince(requestStart);
+    }
     return audioBuffer;
 }
 
-void ChatterBox::applyRepetitionPenalty(float* logits, int64_t vocabSize, const std::vector<int64_t>& generatedTokens, float penalty) {
-    std::unordered_set<int64_t> seenTokens;
-    
-    for (auto id : generatedTokens) {
-        seenTokens.insert(id);
+float* ChatterBox::prefillText(std::vector<int64_t>& inputIds) {
+    int64_t textLength = static_cast<int64_t>(inputIds.size());
+    int64_t promptLength = textLength + condPrefixLength;
+
+    // Present KV is written in place into preallocated buffers, so the whole
+    // sequence has to fit in the cache: the prompt and every position the
+    // decode loop can add, within maxContextLength. The decode buffers are
+    // sized for it too.
+    int64_t maxLength = std::max(std::min(promptLength + MAX_SPEECH_TOKENS, maxContextLength), promptLength + 1);
+    kvCache.reserve(1, maxLength);
+    decodeContext.reserve(1, maxLength, textLength);
+
+    // Start from the cond_emb prefix computed when the style was loaded. The
+    // prefill reads it in place, so no request copies it into the cache.
+    kvCache.restore(condPrefixKeyValues, condPrefixLength);
+
+    // Get embedding from input text, positions continue after the cond_emb prefix
+    std::vector<int64_t> embedTokensInputsDim{1, static_cast<int64_t>(inputIds.size())};
+    Ort::Value embedTokensInput = Ort::Value::CreateTensor<int64_t>(
+        memoryInfo, inputIds.data(), inputIds.size(),
+        embedTokensInputsDim.data(), embedTokensInputsDim.size());
+
+    auto inputsEmbedsOutput = embedTokens->Run(Ort::RunOptions{nullptr},
+        embedTokensInputNames.data(), &embedTokensInput, 1,
+        bertEncoderOutputNames.data(), bertEncoderOutputNames.size());
+
+    // The embeddings are passed to the language model as they are, without a copy
+    decodeContext.prepare(1, kvCache.length(), textLength);
+    return runLanguageModel(inputsEmbedsOutput.front().GetTensorMutableData<float>());
+}
+
+int64_t ChatterBox::selectNextToken(float* logits, int64_t vocabSize, LogitsProcessor& processor, Sampler& tokenSampler) {
+    processor.apply(logits, vocabSize);
+    int64_t tokenId = tokenSampler.sample(logits, vocabSize);
+    processor.observe(tokenId);
+    return tokenId;
+}
+
+float* ChatterBox::runLanguageModel(float* embeds) {
+    bindLanguageModel(embeds);
+    return runBoundLanguageModel();
+}
+
+void ChatterBox::bindLanguageModel(float* embeds) {
+    int64_t newTokens = decodeContext.newTokens();
+
+    // prepare inputs for language model
+    languageModelBinding.ClearBoundInputs();
+    languageModelBinding.ClearBoundOutputs();
+
+    // Input 0..2: inputs_embeds, attention_mask over the cached and new positions,
+    // position_ids following the cached ones; Output 0: logits [1, newTokens, vocab]
+    decodeContext.bind(languageModelBinding, memoryInfo,
+        languageModelInputNames.data(), languageModelOutputNames[0], embeds);
+
+    // Input 3..50: past_key_values, Output 1..48: present, both in the KV cache
+    kvCache.bind(languageModelBinding, memoryInfo,
+        languageModelInputNames.data() + 3, languageModelOutputNames.data() + 1, newTokens);
+}
+
+float* ChatterBox::runBoundLanguageModel() {
+    // Run language model
+    languageModel->Run(Ort::RunOptions{nullptr}, languageModelBinding);
+    kvCache.advance(decodeContext.newTokens());
+    return decodeContext.lastLogits(0);
+}
+
+void ChatterBox::prefillConditioning() {
+    // cond_emb is the same for every request using this style, so its KV
+    // state is computed once here and restored at the start of each request
+    condPrefixKeyValues.clear();
+    condPrefixLength = int64_t(condEmb.size() / HIDDEN_SIZE);
+    if (condPrefixLength == 0) {
+        return;
     }
 
-    for (int64_t id : seenTokens) {
-        float& score = logits[id];
+    RequestArenaScope arenaScope(languageModelArena);
+    int64_t maxLength = condPrefixLength + 1;
+    kvCache.reserve(1, maxLength);
+    decodeContext.reserve(1, maxLength, condPrefixLength);
+    decodeContext.prepare(1, 0, condPrefixLength);
+    runLanguageModel(condEmb.data());
+    kvCache.snapshot(condPrefixKeyValues);
+}
 
-        if (score < 0) {
-            score *= penalty;
-        } else {
-            score /= penalty;
-        }
+std::vector<float> ChatterBox::buildSpeechEmbeddingTable() {
+    // embed_tokens.onnx is a plain lookup, so running it once over every speech
+    // token id yields exactly the rows the per-step 1x1 calls would produce.
+    std::vector<int64_t> speechIds(SPEECH_VOCAB_SIZE);
+    for (int64_t id = 0; id < SPEECH_VOCAB_SIZE; id++) speechIds[id] = id;
+
+    std::vector<int64_t> embedTokensInputsDim{1, SPEECH_VOCAB_SIZE};
+    Ort::Value embedTokensInput = Ort::Value::CreateTensor<int64_t>(
+        memoryInfo, speechIds.data(), speechIds.size(),
+        embedTokensInputsDim.data(), embedTokensInputsDim.size());
+
+    auto inputsEmbedsOutput = embedTokens->Run(Ort::RunOptions{nullptr},
+        embedTokensInputNames.data(), &embedTokensInput, 1,
+        bertEncoderOutputNames.data(), bertEncoderOutputNames.size());
+
+    const float* tableData = inputsEmbedsOutput.front().GetTensorData<float>();
+    size_t tableSize = inputsEmbedsOutput.front().GetTensorTypeAndShapeInfo().GetElementCount();
+    if (tableSize != static_cast<size_t>(SPEECH_VOCAB_SIZE * HIDDEN_SIZE)) {
+        std::cerr << "Unexpected embed_tokens output size, using per-step embedding" << std::endl;
+        return {};
     }
-}
\ No newline at end of file
+    return std::vector<float>(tableData, tableData + tableSize);
+}
+
+void ChatterBox::embedSpeechToken(int64_t tokenId, float* dst) {
+    if (useEmbeddingTable && speechEmbeddingTable && !speechEmbeddingTable->empty() &&
+        tokenId >= 0 && tokenId < SPEECH_VOCAB_SIZE) {
+        const float* row = speechEmbeddingTable->data() + tokenId * HIDDEN_SIZE;
+        std::copy(row, row + HIDDEN_SIZE, dst);
+        return;
+    }
+
+    // Fallback: run embed_tokens.onnx for this single token
+    std::vector<int64_t> nextInputIdVec = {tokenId};
+    std::vector<int64_t> embedTokensInputsDim{1, 1}; // Batch 1, Seq 1
+
+    Ort::Value embedTokensInput = Ort::Value::CreateTensor<int64_t>(
+        memoryInfo, nextInputIdVec.data(), nextInputIdVec.size(),
+        embedTokensInputsDim.data(), embedTokensInputsDim.size());
+
+    auto inputsEmbedsOutput = embedTokens->Run(Ort::RunOptions{nullptr},
+        embedTokensInputNames.data(), &embedTokensInput, 1,
+        bertEncoderOutputNames.data(), bertEncoderOutputNames.size());
+
+    const float* newEmbedData = inputsEmbedsOutput.front().GetTensorData<float>();
+    std::copy(newEmbedData, newEmbedData + HIDDEN_SIZE, dst);
+}
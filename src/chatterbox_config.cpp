@@ -0,0 +1,170 @@
+#include "chatterbox_config.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+GraphOptimizationLevel parseOptimizationLevel(const std::string& name) {
+    if (name == "disable_all") return GraphOptimizationLevel::ORT_DISABLE_ALL;
+    if (name == "basic") return GraphOptimizationLevel::ORT_ENABLE_BASIC;
+    if (name == "extended") return GraphOptimizationLevel::ORT_ENABLE_EXTENDED;
+    if (name == "all") return GraphOptimizationLevel::ORT_ENABLE_ALL;
+    throw std::invalid_argument("unknown graph_optimization_level: " + name);
+}
+
+ExecutionMode parseExecutionMode(const std::string& name) {
+    if (name == "sequential") return ExecutionMode::ORT_SEQUENTIAL;
+    if (name == "parallel") return ExecutionMode::ORT_PARALLEL;
+    throw std::invalid_argument("unknown execution_mode: " + name);
+}
+
+void applySessionConfig(const json& node, SessionConfig& config) {
+    if (node.contains("graph_optimization_level")) {
+        config.optimizationLevel = parseOptimizationLevel(node["graph_optimization_level"].get<std::string>());
+    }
+    if (node.contains("intra_op_threads")) {
+        config.intraOpThreads = node["intra_op_threads"].get<int>();
+    }
+    if (node.contains("inter_op_threads")) {
+        config.interOpThreads = node["inter_op_threads"].get<int>();
+    }
+    if (node.contains("execution_mode")) {
+        config.executionMode = parseExecutionMode(node["execution_mode"].get<std::string>());
+    }
+    if (node.contains("cpu_mem_arena")) {
+        config.enableCpuMemArena = node["cpu_mem_arena"].get<bool>();
+    }
+    if (node.contains("mem_pattern")) {
+        config.enableMemPattern = node["mem_pattern"].get<bool>();
+    }
+    if (node.contains("denormals_as_zero")) {
+        config.denormalsAsZero = node["denormals_as_zero"].get<bool>();
+    }
+    if (node.contains("request_arena")) {
+        config.requestArena = node["request_arena"].get<bool>();
+    }
+}
+
+} // namespace
+
+bool ChatterBoxConfig::loadFromFile(const std::string& filepath) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open config file: " << filepath << std::endl;
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return loadFromString(buffer.str());
+}
+
+bool ChatterBoxConfig::loadFromString(const std::string& text) {
+    try {
+        json config = json::parse(text);
+
+        if (config.contains("use_cuda")) {
+            useCuda = config["use_cuda"].get<bool>();
+        }
+        if (config.contains("use_embedding_table")) {
+            useEmbeddingTable = config["use_embedding_table"].get<bool>();
+        }
+        if (config.contains("max_context_length")) {
+            maxContextLength = config["max_context_length"].get<int64_t>();
+        }
+        if (config.contains("repetition_penalty")) {
+            repetitionPenalty = config["repetition_penalty"].get<float>();
+        }
+        if (config.contains("sampling")) {
+            const json& node = config["sampling"];
+            if (node.contains("temperature")) {
+                sampling.temperature = node["temperature"].get<float>();
+            }
+            if (node.contains("top_k")) {
+                sampling.topK = node["top_k"].get<int>();
+            }
+            if (node.contains("top_p")) {
+                sampling.topP = node["top_p"].get<float>();
+            }
+            if (node.contains("min_p")) {
+                sampling.minP = node["min_p"].get<float>();
+            }
+            if (node.contains("seed")) {
+                sampling.seed = node["seed"].get<uint64_t>();
+            }
+        }
+        if (config.contains("optimized_model_cache_dir")) {
+            optimizedModelCacheDir = config["optimized_model_cache_dir"].get<std::string>();
+        }
+        if (config.contains("metrics_log")) {
+            metricsLog = config["metrics_log"].get<std::string>();
+        }
+
+        if (config.contains("sessions")) {
+            const json& sessions = config["sessions"];
+            if (sessions.contains("default")) {
+                applySessionConfig(sessions["default"], languageModel);
+                applySessionConfig(sessions["default"], conditionalDecoder);
+                applySessionConfig(sessions["default"], embedTokens);
+            }
+            if (sessions.contains("language_model")) {
+                applySessionConfig(sessions["language_model"], languageModel);
+            }
+            if (sessions.contains("conditional_decoder")) {
+                applySessionConfig(sessions["conditional_decoder"], conditionalDecoder);
+            }
+            if (sessions.contains("embed_tokens")) {
+                applySessionConfig(sessions["embed_tokens"], embedTokens);
+            }
+        }
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading config: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+Ort::SessionOptions createSessionOptions(const SessionConfig& config, bool useCuda) {
+    Ort::SessionOptions sessionOptions;
+
+    if (useCuda) {
+        // Use CUDA provider
+        OrtCUDAProviderOptions cuda_options{};
+        cuda_options.cudnn_conv_algo_search = OrtCudnnConvAlgoSearchHeuristic;
+        sessionOptions.AppendExecutionProvider_CUDA(cuda_options);
+    }
+    sessionOptions.SetGraphOptimizationLevel(config.optimizationLevel);
+    sessionOptions.SetExecutionMode(config.executionMode);
+    if (config.intraOpThreads > 0) {
+        sessionOptions.SetIntraOpNumThreads(config.intraOpThreads);
+    }
+    if (config.interOpThreads > 0) {
+        sessionOptions.SetInterOpNumThreads(config.interOpThreads);
+    }
+
+    if (config.enableCpuMemArena) {
+        sessionOptions.EnableCpuMemArena();
+    } else {
+        sessionOptions.DisableCpuMemArena();
+    }
+    if (config.enableMemPattern) {
+        sessionOptions.EnableMemPattern();
+    } else {
+        sessionOptions.DisableMemPattern();
+    }
+    if (config.denormalsAsZero) {
+        sessionOptions.AddConfigEntry("session.set_denormal_as_zero", "1");
+    }
+    if (config.requestArena) {
+        // CPU memory then comes from requestArenaAllocator(), registered with the Env
+        sessionOptions.AddConfigEntry("session.use_env_allocators", "1");
+    }
+    sessionOptions.DisableProfiling();
+    return sessionOptions;
+}
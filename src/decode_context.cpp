@@ -0,0 +1,68 @@
+#include "decode_context.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+
+// Grow only, so steady-state calls never reallocate
+template <typename T>
+void ensureSize(std::vector<T>& buffer, int64_t size) {
+    if (static_cast<int64_t>(buffer.size()) < size) {
+        buffer.resize(static_cast<size_t>(size));
+    }
+}
+
+} // namespace
+
+DecodeContext::DecodeContext(int64_t hiddenSize, int64_t vocabSize)
+    : hiddenSize_(hiddenSize), vocabSize_(vocabSize) {}
+
+void DecodeContext::reserve(int64_t batchSize, int64_t maxLength, int64_t maxNewTokens) {
+    ensureSize(embeds_, batchSize * maxNewTokens * hiddenSize_);
+    ensureSize(mask_, batchSize * maxLength);
+    ensureSize(positionIds_, batchSize * maxNewTokens);
+    ensureSize(logits_, batchSize * maxNewTokens * vocabSize_);
+}
+
+void DecodeContext::prepare(int64_t batchSize, int64_t pastLength, int64_t newTokens) {
+    batchSize_ = batchSize;
+    totalLength_ = pastLength + newTokens;
+    newTokens_ = newTokens;
+    reserve(batchSize, totalLength_, newTokens);
+
+    std::fill(mask_.begin(), mask_.begin() + batchSize * totalLength_, 1);
+    for (int64_t b = 0; b < batchSize; b++) {
+        for (int64_t k = 0; k < newTokens; k++) {
+            positionIds_[b * newTokens + k] = pastLength + k;
+        }
+    }
+}
+
+void DecodeContext::bind(Ort::IoBinding& binding, const Ort::MemoryInfo& memoryInfo,
+                         const char* const* inputNames, const char* logitsName, float* embeds) {
+    std::array<int64_t, 3> embedsShape{batchSize_, newTokens_, hiddenSize_};
+    std::array<int64_t, 2> maskShape{batchSize_, totalLength_};
+    std::array<int64_t, 2> positionIdsShape{batchSize_, newTokens_};
+    std::array<int64_t, 3> logitsShape{batchSize_, newTokens_, vocabSize_};
+
+    Ort::Value inputsEmbeds = Ort::Value::CreateTensor<float>(
+        memoryInfo, embeds != nullptr ? embeds : embeds_.data(),
+        static_cast<size_t>(batchSize_ * newTokens_ * hiddenSize_),
+        embedsShape.data(), embedsShape.size());
+    binding.BindInput(inputNames[0], inputsEmbeds);
+
+    Ort::Value attentionMask = Ort::Value::CreateTensor<int64_t>(
+        memoryInfo, mask_.data(), static_cast<size_t>(batchSize_ * totalLength_),
+        maskShape.data(), maskShape.size());
+    binding.BindInput(inputNames[1], attentionMask);
+
+    Ort::Value positionIds = Ort::Value::CreateTensor<int64_t>(
+        memoryInfo, positionIds_.data(), static_cast<size_t>(batchSize_ * newTokens_),
+        positionIdsShape.data(), positionIdsShape.size());
+    binding.BindInput(inputNames[2], positionIds);
+
+    Ort::Value logits = Ort::Value::CreateTensor<float>(
+        memoryInfo, logits_.data(), static_cast<size_t>(batchSize_ * newTokens_ * vocabSize_),
+        logitsShape.data(), logitsShape.size());
+    binding.BindOutput(logitsName, logits);
+}
@@ -0,0 +1,146 @@
+#include "kv_cache.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+KVCache::KVCache(int64_t numLayers, int64_t numHeads, int64_t headDim)
+    : numLayers_(numLayers), numHeads_(numHeads), headDim_(headDim) {
+    for (auto& side : buffers_) {
+        side.resize(tensorCount());
+    }
+}
+
+void KVCache::reserve(int64_t batchSize, int64_t maxLength) {
+    batchSize_ = batchSize;
+    length_ = 0;
+    current_ = 0;
+    prefix_ = nullptr;
+    if (batchSize <= rowCapacity_ && maxLength <= capacity_) {
+        return;
+    }
+
+    rowCapacity_ = std::max(batchSize, rowCapacity_);
+    capacity_ = std::max(maxLength, capacity_);
+    size_t tensorSize = static_cast<size_t>(rowCapacity_ * numHeads_ * capacity_ * headDim_);
+    for (auto& side : buffers_) {
+        for (auto& buffer : side) {
+            // Release the old buffer first so both sizes are never held at once
+            buffer.reset();
+            buffer.reset(new float[tensorSize]);
+        }
+    }
+}
+
+void KVCache::grow(int64_t batchSize, int64_t maxLength) {
+    if (batchSize <= rowCapacity_ && maxLength <= capacity_) {
+        return;
+    }
+
+    rowCapacity_ = std::max(batchSize, rowCapacity_);
+    capacity_ = std::max(maxLength, capacity_);
+    size_t tensorSize = static_cast<size_t>(rowCapacity_ * numHeads_ * capacity_ * headDim_);
+    size_t count = static_cast<size_t>(batchSize_ * numHeads_ * length_ * headDim_);
+    for (int64_t j = 0; j < tensorCount(); j++) {
+        buffers_[1 - current_][j].reset();
+        std::unique_ptr<float[]> buffer(new float[tensorSize]);
+        if (count > 0) {
+            std::copy(pastData(j), pastData(j) + count, buffer.get());
+        }
+        buffers_[current_][j] = std::move(buffer);
+        buffers_[1 - current_][j].reset(new float[tensorSize]);
+    }
+    prefix_ = nullptr;
+}
+
+void KVCache::relayout(const std::vector<int64_t>& keepRows, int64_t newLength) {
+    int64_t copied = std::min(length_, newLength);
+    int64_t padding = newLength - copied;
+
+    for (int64_t j = 0; j < tensorCount(); j++) {
+        const float* src = pastData(j);
+        float* dst = buffers_[1 - current_][j].get();
+        for (size_t r = 0; r < keepRows.size(); r++) {
+            for (int64_t h = 0; h < numHeads_; h++) {
+                const float* srcRow = src + ((keepRows[r] * numHeads_ + h) * length_ + (length_ - copied)) * headDim_;
+                float* dstRow = dst + ((static_cast<int64_t>(r) * numHeads_ + h) * newLength) * headDim_;
+                std::fill(dstRow, dstRow + padding * headDim_, 0.0f);
+                std::copy(srcRow, srcRow + copied * headDim_, dstRow + padding * headDim_);
+            }
+        }
+    }
+
+    current_ = 1 - current_;
+    prefix_ = nullptr;
+    batchSize_ = static_cast<int64_t>(keepRows.size());
+    length_ = newLength;
+}
+
+void KVCache::appendRow(const std::vector<std::vector<float>>& tensors, int64_t rowLength) {
+    int64_t padding = length_ - rowLength;
+    int64_t row = batchSize_;
+
+    for (int64_t j = 0; j < tensorCount(); j++) {
+        float* dst = buffers_[current_][j].get();
+        for (int64_t h = 0; h < numHeads_; h++) {
+            const float* srcRow = tensors[j].data() + h * rowLength * headDim_;
+            float* dstRow = dst + ((row * numHeads_ + h) * length_) * headDim_;
+            std::fill(dstRow, dstRow + padding * headDim_, 0.0f);
+            std::copy(srcRow, srcRow + rowLength * headDim_, dstRow + padding * headDim_);
+        }
+    }
+    batchSize_++;
+}
+
+void KVCache::snapshot(std::vector<std::vector<float>>& tensors) const {
+    size_t count = static_cast<size_t>(numHeads_ * length_ * headDim_);
+    tensors.resize(tensorCount());
+    for (int64_t j = 0; j < tensorCount(); j++) {
+        const float* src = pastData(j);
+        tensors[j].assign(src, src + count);
+    }
+}
+
+void KVCache::restore(const std::vector<std::vector<float>>& tensors, int64_t length) {
+    if (tensors.empty() || length == 0) {
+        length_ = 0;
+        prefix_ = nullptr;
+        return;
+    }
+    if (length > capacity_) {
+        throw std::length_error("KV cache holds " + std::to_string(capacity_) +
+                                " positions, the restored prefix has " + std::to_string(length));
+    }
+
+    // Read in place by the next run; its present output lands in the buffers
+    prefix_ = &tensors;
+    length_ = length;
+}
+
+void KVCache::bind(Ort::IoBinding& binding, const Ort::MemoryInfo& memoryInfo,
+                   const char* const* pastNames, const char* const* presentNames,
+                   int64_t newTokens) {
+    std::array<int64_t, 4> pastShape{batchSize_, numHeads_, length_, headDim_};
+    std::array<int64_t, 4> presentShape{batchSize_, numHeads_, length_ + newTokens, headDim_};
+    size_t pastCount = static_cast<size_t>(batchSize_ * numHeads_ * length_ * headDim_);
+    size_t presentCount = static_cast<size_t>(batchSize_ * numHeads_ * (length_ + newTokens) * headDim_);
+
+    for (int64_t j = 0; j < tensorCount(); j++) {
+        // Tensors are contiguous [B, H, len, D] views over the front of each
+        // buffer; the past may be a restored snapshot, which ORT only reads
+        Ort::Value past = Ort::Value::CreateTensor<float>(
+            memoryInfo, const_cast<float*>(pastData(j)), pastCount,
+            pastShape.data(), pastShape.size());
+        binding.BindInput(pastNames[j], past);
+
+        Ort::Value present = Ort::Value::CreateTensor<float>(
+            memoryInfo, buffers_[1 - current_][j].get(), presentCount,
+            presentShape.data(), presentShape.size());
+        binding.BindOutput(presentNames[j], present);
+    }
+}
+
+void KVCache::advance(int64_t newTokens) {
+    current_ = 1 - current_;
+    prefix_ = nullptr;
+    length_ += newTokens;
+}
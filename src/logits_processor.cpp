@@ -0,0 +1,278 @@
+#include "logits_processor.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LOGITS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define LOGITS_TARGET(isa)
+#else
+#define LOGITS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define LOGITS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr float NEGATIVE_INFINITY = -std::numeric_limits<float>::infinity();
+
+struct Kernels {
+    float (*maxValue)(const float* values, int64_t count);
+    int64_t (*find)(const float* values, int64_t count, float target);  // first index equal to target
+    const char* name;
+};
+
+float maxValueScalar(const float* values, int64_t count) {
+    float best = NEGATIVE_INFINITY;
+    for (int64_t i = 0; i < count; i++) {
+        if (values[i] > best) best = values[i];
+    }
+    return best;
+}
+
+int64_t findScalar(const float* values, int64_t count, float target) {
+    for (int64_t i = 0; i < count; i++) {
+        if (values[i] == target) return i;
+    }
+    return 0;
+}
+
+#if defined(LOGITS_X86)
+
+inline int lowestBit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// max(x, acc) returns acc when x is NaN, so NaN never enters the accumulators
+
+LOGITS_TARGET("avx2")
+float maxValueAvx2(const float* values, int64_t count) {
+    __m256 acc0 = _mm256_set1_ps(NEGATIVE_INFINITY);
+    __m256 acc1 = acc0;
+    __m256 acc2 = acc0;
+    __m256 acc3 = acc0;
+    int64_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        acc0 = _mm256_max_ps(_mm256_loadu_ps(values + i), acc0);
+        acc1 = _mm256_max_ps(_mm256_loadu_ps(values + i + 8), acc1);
+        acc2 = _mm256_max_ps(_mm256_loadu_ps(values + i + 16), acc2);
+        acc3 = _mm256_max_ps(_mm256_loadu_ps(values + i + 24), acc3);
+    }
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_max_ps(_mm256_loadu_ps(values + i), acc0);
+    }
+    __m256 acc = _mm256_max_ps(_mm256_max_ps(acc0, acc1), _mm256_max_ps(acc2, acc3));
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    float best = _mm_cvtss_f32(half);
+    for (; i < count; i++) {
+        if (values[i] > best) best = values[i];
+    }
+    return best;
+}
+
+LOGITS_TARGET("avx2")
+int64_t findAvx2(const float* values, int64_t count, float target) {
+    __m256 wanted = _mm256_set1_ps(target);
+    int64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        unsigned mask = static_cast<unsigned>(
+            _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), wanted, _CMP_EQ_OQ)));
+        if (mask != 0) return i + lowestBit(mask);
+    }
+    for (; i < count; i++) {
+        if (values[i] == target) return i;
+    }
+    return 0;
+}
+
+// GCC 12 warns about the deliberately undefined registers inside its AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+LOGITS_TARGET("avx512f")
+float maxValueAvx512(const float* values, int64_t count) {
+    __m512 lowest = _mm512_set1_ps(NEGATIVE_INFINITY);
+    __m512 acc0 = lowest;
+    __m512 acc1 = lowest;
+    int64_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        acc0 = _mm512_max_ps(_mm512_loadu_ps(values + i), acc0);
+        acc1 = _mm512_max_ps(_mm512_loadu_ps(values + i + 16), acc1);
+    }
+    for (; i < count; i += 16) {
+        // The last partial block loads -infinity into the missing lanes
+        int64_t remaining = count - i;
+        __mmask16 lanes = remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1);
+        acc0 = _mm512_max_ps(_mm512_mask_loadu_ps(lowest, lanes, values + i), acc0);
+    }
+    return _mm512_reduce_max_ps(_mm512_max_ps(acc0, acc1));
+}
+
+LOGITS_TARGET("avx512f")
+int64_t findAvx512(const float* values, int64_t count, float target) {
+    __m512 wanted = _mm512_set1_ps(target);
+    for (int64_t i = 0; i < count; i += 16) {
+        int64_t remaining = count - i;
+        __mmask16 lanes = remaining >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << remaining) - 1);
+        __mmask16 equal = _mm512_mask_cmp_ps_mask(lanes, _mm512_maskz_loadu_ps(lanes, values + i),
+                                                  wanted, _CMP_EQ_OQ);
+        if (equal != 0) return i + lowestBit(equal);
+    }
+    return 0;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuHasAvx512() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesAvx512 = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0xE6) == 0xE6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx512 && (info[1] & (1 << 16)) != 0;
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#elif defined(LOGITS_NEON)
+
+float maxValueNeon(const float* values, int64_t count) {
+    // vmaxnmq returns the number when one operand is NaN
+    float32x4_t acc0 = vdupq_n_f32(NEGATIVE_INFINITY);
+    float32x4_t acc1 = acc0;
+    int64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vmaxnmq_f32(vld1q_f32(values + i), acc0);
+        acc1 = vmaxnmq_f32(vld1q_f32(values + i + 4), acc1);
+    }
+    float best = vmaxnmvq_f32(vmaxnmq_f32(acc0, acc1));
+    for (; i < count; i++) {
+        if (values[i] > best) best = values[i];
+    }
+    return best;
+}
+
+int64_t findNeon(const float* values, int64_t count, float target) {
+    float32x4_t wanted = vdupq_n_f32(target);
+    int64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        if (vmaxvq_u32(vceqq_f32(vld1q_f32(values + i), wanted)) != 0) break;
+    }
+    for (; i < count; i++) {
+        if (values[i] == target) return i;
+    }
+    return 0;
+}
+
+#endif
+
+Kernels selectKernels() {
+#if defined(LOGITS_X86)
+    if (cpuHasAvx512()) return Kernels{maxValueAvx512, findAvx512, "avx512"};
+    if (cpuHasAvx2()) return Kernels{maxValueAvx2, findAvx2, "avx2"};
+#elif defined(LOGITS_NEON)
+    return Kernels{maxValueNeon, findNeon, "neon"};
+#endif
+    return Kernels{maxValueScalar, findScalar, "scalar"};
+}
+
+const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+} // namespace
+
+namespace logits {
+
+float maxValue(const float* values, int64_t count) {
+    return kernels().maxValue(values, count);
+}
+
+int64_t argmax(const float* values, int64_t count) {
+    const Kernels& selected = kernels();
+    float best = selected.maxValue(values, count);
+    if (best == NEGATIVE_INFINITY) {
+        return 0;
+    }
+    return selected.find(values, count, best);
+}
+
+const char* kernelName() {
+    return kernels().name;
+}
+
+} // namespace logits
+
+LogitsProcessor::LogitsProcessor(float repetitionPenalty, int64_t vocabSize)
+    : repetitionPenalty(repetitionPenalty),
+      seenBits(static_cast<size_t>((std::max<int64_t>(vocabSize, 0) + 63) / 64), 0) {
+    seenTokens.reserve(static_cast<size_t>(std::max<int64_t>(vocabSize, 0)));
+}
+
+void LogitsProcessor::reset() {
+    for (int64_t id : seenTokens) {
+        seenBits[id >> 6] = 0;
+    }
+    seenTokens.clear();
+}
+
+void LogitsProcessor::observe(int64_t tokenId) {
+    if (tokenId < 0) {
+        return;
+    }
+    size_t word = static_cast<size_t>(tokenId >> 6);
+    uint64_t bit = uint64_t(1) << (tokenId & 63);
+    if (word >= seenBits.size()) {
+        seenBits.resize(word + 1, 0);
+    }
+    if ((seenBits[word] & bit) == 0) {
+        seenBits[word] |= bit;
+        seenTokens.push_back(tokenId);
+    }
+}
+
+void LogitsProcessor::apply(float* logits, int64_t vocabSize) const {
+    if (repetitionPenalty == 1.0f) {
+        return;
+    }
+    for (int64_t id : seenTokens) {
+        if (id >= vocabSize) continue;
+        float& score = logits[id];
+        if (score < 0) {
+            score *= repetitionPenalty;
+        } else {
+            score /= repetitionPenalty;
+        }
+    }
+}
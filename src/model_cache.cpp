@@ -0,0 +1,244 @@
+#include "model_cache.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// FNV-1a over 64-bit words, so hashing a model of several hundred MB stays
+// well below the time it takes to optimize it
+uint64_t hashFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    std::vector<uint64_t> buffer(1 << 17);
+    while (file) {
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(uint64_t));
+        size_t bytesRead = static_cast<size_t>(file.gcount());
+        size_t words = bytesRead / sizeof(uint64_t);
+        for (size_t i = 0; i < words; i++) {
+            hash ^= buffer[i];
+            hash *= FNV_PRIME;
+        }
+        hash = fnv1a(hash, reinterpret_cast<const char*>(buffer.data()) + words * sizeof(uint64_t),
+                     bytesRead - words * sizeof(uint64_t));
+    }
+    return hash;
+}
+
+// External initializer files of a model: files next to it whose name appears in
+// the model, where ONNX stores the location of external tensor data. Their size
+// and modification time stand in for a content hash, which would mean reading
+// gigabytes of weights at every start.
+uint64_t hashExternalData(const fs::path& modelPath) {
+    MappedFile modelFile;
+    if (!modelFile.open(modelPath.string())) {
+        return 0;
+    }
+    std::string_view modelBytes(static_cast<const char*>(modelFile.data()), modelFile.size());
+
+    std::vector<fs::path> dataFiles;
+    std::error_code ec;
+    fs::path folder = modelPath.has_parent_path() ? modelPath.parent_path() : fs::path(".");
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file(ec) && entry.path() != modelPath && entry.path().extension() != ".onnx" &&
+            modelBytes.find(name) != std::string_view::npos) {
+            dataFiles.push_back(entry.path());
+        }
+    }
+    std::sort(dataFiles.begin(), dataFiles.end());
+
+    uint64_t hash = FNV_OFFSET;
+    for (const fs::path& path : dataFiles) {
+        std::string name = path.filename().string();
+        uint64_t size = static_cast<uint64_t>(fs::file_size(path, ec));
+        int64_t modified = static_cast<int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+        hash = fnv1a(hash, name.data(), name.size());
+        hash = fnv1a(hash, &size, sizeof(size));
+        hash = fnv1a(hash, &modified, sizeof(modified));
+    }
+    return hash;
+}
+
+// Create a session from the model file. ORT copies the initializers into its
+// own buffers either way, so the file is passed by path; external data is then
+// resolved relative to the model.
+Ort::Session loadSession(const Ort::Env& env, const fs::path& modelPath,
+                         Ort::SessionOptions& sessionOptions,
+                         OrtPrepackedWeightsContainer* prepackedWeights) {
+    std::error_code ec;
+    if (!fs::is_regular_file(modelPath, ec)) {
+        throw std::runtime_error("Cannot open model file: " + modelPath.string());
+    }
+
+    if (prepackedWeights != nullptr) {
+        return Ort::Session(env, modelPath.c_str(), sessionOptions, prepackedWeights);
+    }
+    return Ort::Session(env, modelPath.c_str(), sessionOptions);
+}
+
+// Remove the data files written with the graph cacheDir/<graphName>
+void removeDataFiles(const std::string& cacheDir, const std::string& graphName) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(cacheDir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (entry.path().extension() == ".data" && name.rfind(graphName, 0) == 0) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+}
+
+std::string hexKey(uint64_t hash) {
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+    return key;
+}
+
+} // namespace
+
+std::string describeSessionOptions(const SessionConfig& config, bool useCuda) {
+    std::ostringstream options;
+    options << "opt=" << static_cast<int>(config.optimizationLevel)
+            << ";intra=" << config.intraOpThreads
+            << ";inter=" << config.interOpThreads
+            << ";mode=" << static_cast<int>(config.executionMode)
+            << ";arena=" << config.enableCpuMemArena
+            << ";pattern=" << config.enableMemPattern
+            << ";ftz=" << config.denormalsAsZero
+            << ";cuda=" << useCuda;
+    return options.str();
+}
+
+std::string modelCacheKey(const std::string& modelPath, const SessionConfig& config, bool useCuda) {
+    // <options>.<model + ORT version>, so entries of one option set can be
+    // told apart from those of another when invalidating
+    std::string options = describeSessionOptions(config, useCuda);
+    std::string version = Ort::GetVersionString();
+    uint64_t contentHash = fnv1a(hashFile(modelPath), version.data(), version.size());
+    uint64_t dataHash = hashExternalData(modelPath);
+    contentHash = fnv1a(contentHash, &dataHash, sizeof(dataHash));
+    return hexKey(fnv1a(FNV_OFFSET, options.data(), options.size())) + "." + hexKey(contentHash);
+}
+
+Ort::Session createCachedSession(const Ort::Env& env, const std::string& modelPath,
+                                 const SessionConfig& config, bool useCuda,
+                                 const std::string& cacheDir,
+                                 OrtPrepackedWeightsContainer* prepackedWeights) {
+    fs::path model(modelPath);
+    if (cacheDir.empty() || config.optimizationLevel == GraphOptimizationLevel::ORT_DISABLE_ALL) {
+        Ort::SessionOptions sessionOptions = createSessionOptions(config, useCuda);
+        return loadSession(env, model, sessionOptions, prepackedWeights);
+    }
+
+    std::string key = modelCacheKey(modelPath, config, useCuda);
+    std::string prefix = model.stem().string() + "." + key.substr(0, 16) + ".";
+    fs::path cached = fs::path(cacheDir) / (prefix + key.substr(17) + ".onnx");
+
+    std::error_code ec;
+    if (fs::exists(cached, ec)) {
+        // Already optimized: skip the graph transformations at load time
+        SessionConfig cachedConfig = config;
+        cachedConfig.optimizationLevel = GraphOptimizationLevel::ORT_DISABLE_ALL;
+        try {
+            Ort::SessionOptions sessionOptions = createSessionOptions(cachedConfig, useCuda);
+            return loadSession(env, cached, sessionOptions, prepackedWeights);
+        } catch (const Ort::Exception& e) {
+            std::cerr << "Discarding unreadable optimized model " << cached.string() << ": " << e.what() << std::endl;
+            fs::remove(cached, ec);
+            removeDataFiles(cacheDir, cached.filename().string());
+        }
+    }
+
+    // Optimize the original model and keep the result. Its weights go to a data
+    // file, as protobuf cannot hold more than 2 GB, which the optimized graph
+    // refers to by name; so both are written under their final names into a
+    // temporary directory and moved into the cache, data first, so other
+    // processes never see a partial entry.
+    fs::create_directories(cacheDir, ec);
+    std::string current = cached.filename().string();
+    fs::path temporaryDir = fs::path(cacheDir) / (current + ".tmp" + std::to_string(std::random_device{}()));
+    fs::path temporary = temporaryDir / current;
+    fs::path cachedData = cached;
+    cachedData += ".data";
+    fs::create_directories(temporaryDir, ec);
+
+    Ort::Session session(nullptr);
+    try {
+        Ort::SessionOptions sessionOptions = createSessionOptions(config, useCuda);
+        sessionOptions.SetOptimizedModelFilePath(temporary.c_str());
+        sessionOptions.AddConfigEntry("session.optimized_model_external_initializers_file_name",
+                                      cachedData.filename().string().c_str());
+        session = loadSession(env, model, sessionOptions, prepackedWeights);
+    } catch (const Ort::Exception& e) {
+        // For example an ORT version that cannot write external initializers; run uncached
+        std::cerr << "Cannot cache optimized model " << cached.string() << ": " << e.what() << std::endl;
+        fs::remove_all(temporaryDir, ec);
+        Ort::SessionOptions sessionOptions = createSessionOptions(config, useCuda);
+        return loadSession(env, model, sessionOptions, prepackedWeights);
+    }
+
+    // A graph small enough to need no initializers has no data file
+    fs::path temporaryData = temporaryDir / cachedData.filename();
+    if (fs::exists(temporaryData, ec)) {
+        fs::rename(temporaryData, cachedData, ec);
+    }
+    if (!ec) {
+        fs::rename(temporary, cached, ec);
+    }
+    if (ec) {
+        std::cerr << "Failed to store optimized model " << cached.string() << ": " << ec.message() << std::endl;
+    }
+    fs::remove_all(temporaryDir, ec);
+
+    // Entries (graphs and their data files) of this model and option set under an
+    // older model or ORT version are stale now, and so are temporary files a
+    // crashed or killed writer left behind. Temporary entries younger than an
+    // hour may belong to a writer that is still optimizing and are kept.
+    auto abandoned = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    for (const auto& entry : fs::directory_iterator(cacheDir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) != 0) {
+            continue;
+        }
+        if (name.find(".tmp") != std::string::npos) {
+            std::error_code timeError;
+            if (entry.last_write_time(timeError) < abandoned && !timeError) {
+                fs::remove_all(entry.path(), ec);
+            }
+            continue;
+        }
+        bool entryFile = entry.path().extension() == ".onnx" || entry.path().extension() == ".data";
+        if (entryFile && name.rfind(current, 0) != 0) {
+            fs::remove(entry.path(), ec);
+        }
+    }
+    return session;
+}
@@ -0,0 +1,55 @@
+#include "model_registry.h"
+#include "model_cache.h"
+#include "request_arena.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+ModelRegistry& ModelRegistry::instance() {
+    // Never destroyed: sessions still referenced during static destruction
+    // must not outlive the Env they were created in.
+    static ModelRegistry* registry = new ModelRegistry();
+    return *registry;
+}
+
+ModelRegistry::ModelRegistry()
+    : env_(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "Chatterbox-turbo") {
+    env_.DisableTelemetryEvents();
+    env_.RegisterAllocator(requestArenaAllocator());
+}
+
+std::shared_ptr<Ort::Session> ModelRegistry::getSession(const std::string& modelPath,
+                                                        const SessionConfig& config, bool useCuda,
+                                                        const std::string& cacheDir) {
+    std::error_code ec;
+    fs::path canonicalPath = fs::weakly_canonical(modelPath, ec);
+    // The allocator does not change the optimized model, so it is only part of
+    // this key and not of the model cache key
+    std::string key = (ec ? modelPath : canonicalPath.string()) + "|" +
+                      describeSessionOptions(config, useCuda) + ";request_arena=" +
+                      std::to_string(config.requestArena) + "|" + cacheDir;
+
+    // Held while loading so concurrent callers wait for one load instead of
+    // each creating their own copy
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::shared_ptr<Ort::Session> session = sessions_[key].lock()) {
+        return session;
+    }
+
+    auto session = std::make_shared<Ort::Session>(
+        createCachedSession(env_, modelPath, config, useCuda, cacheDir, prepackedWeights_));
+    sessions_[key] = session;
+    return session;
+}
+
+std::shared_ptr<const std::vector<float>> ModelRegistry::getTable(
+    const std::string& key, const std::function<std::vector<float>()>& build) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (std::shared_ptr<const std::vector<float>> table = tables_[key].lock()) {
+        return table;
+    }
+
+    auto table = std::make_shared<const std::vector<float>>(build());
+    tables_[key] = table;
+    return table;
+}
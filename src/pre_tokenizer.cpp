@@ -0,0 +1,89 @@
+#include "pre_tokenizer.hpp"
+#include "unicode_categories.hpp"
+#include "utf8.hpp"
+
+namespace {
+
+enum class CharClass { Letter, Number, Whitespace, Other };
+
+CharClass classify(char32_t cp) {
+    if (unicode::isLetter(cp)) return CharClass::Letter;
+    if (unicode::isNumber(cp)) return CharClass::Number;
+    if (unicode::isWhitespace(cp)) return CharClass::Whitespace;
+    return CharClass::Other;
+}
+
+// Length of 's 't 're 've 'm 'll 'd at the start of s, 0 if none
+size_t contractionLength(const char* s, size_t available) {
+    if (available < 2 || s[0] != '\'') return 0;
+    switch (s[1]) {
+    case 's': case 't': case 'm': case 'd':
+        return 2;
+    case 'r': case 'v':
+        return available >= 3 && s[2] == 'e' ? 3 : 0;
+    case 'l':
+        return available >= 3 && s[2] == 'l' ? 3 : 0;
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+bool PreTokenizer::next(std::string_view& piece) {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    const char* start = begin + pos;
+    if (start >= end) {
+        return false;
+    }
+
+    const char* cursor = start;
+    size_t contraction = contractionLength(cursor, static_cast<size_t>(end - cursor));
+    if (contraction > 0) {
+        cursor += contraction;
+    } else {
+        char32_t cp;
+        size_t length = unicode::decodeUtf8(cursor, end, cp);
+        CharClass cls = classify(cp);
+
+        // " ?\p{L}+", " ?\p{N}+" and " ?[^\s\p{L}\p{N}]+" take one leading space
+        if (cp == ' ' && cursor + length < end) {
+            char32_t nextCp;
+            unicode::decodeUtf8(cursor + length, end, nextCp);
+            CharClass nextCls = classify(nextCp);
+            if (nextCls != CharClass::Whitespace) {
+                cursor += length;
+                cls = nextCls;
+            }
+        }
+
+        if (cls != CharClass::Whitespace) {
+            // Longest run of the class
+            while (cursor < end) {
+                length = unicode::decodeUtf8(cursor, end, cp);
+                if (classify(cp) != cls) break;
+                cursor += length;
+            }
+        } else {
+            // "\s+(?!\S)|\s+": a whitespace run followed by text gives up its
+            // last character, which then prefixes the next piece
+            const char* lastStart = cursor;
+            size_t count = 0;
+            while (cursor < end) {
+                length = unicode::decodeUtf8(cursor, end, cp);
+                if (!unicode::isWhitespace(cp)) break;
+                lastStart = cursor;
+                cursor += length;
+                count++;
+            }
+            if (cursor < end && count > 1) {
+                cursor = lastStart;
+            }
+        }
+    }
+
+    piece = std::string_view(start, static_cast<size_t>(cursor - start));
+    pos = static_cast<size_t>(cursor - begin);
+    return true;
+}
@@ -0,0 +1,264 @@
+#include "request_arena.h"
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr size_t ALIGNMENT = 64;
+
+// Block sizes up to this are multiples of ALIGNMENT, one size class each
+constexpr size_t SMALL_LIMIT = 1024;
+constexpr size_t SMALL_CLASSES = SMALL_LIMIT / ALIGNMENT;
+
+// In front of every block, one alignment unit long so the payload stays aligned
+struct alignas(ALIGNMENT) BlockHeader {
+    RequestArena::State* arena;     // nullptr = heap block
+    size_t size;                    // bytes including this header
+    size_t sizeClass;
+};
+static_assert(sizeof(BlockHeader) == ALIGNMENT, "block header must keep payloads aligned");
+
+size_t roundUp(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+size_t highestBit(size_t value) {
+    size_t bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+// Round a block size up to its size class: multiples of ALIGNMENT up to
+// SMALL_LIMIT, then four classes per power of two. A freed block can hold any
+// later block of its class; above SMALL_LIMIT at most a fifth of it is padding.
+size_t sizeClassOf(size_t& size) {
+    if (size <= SMALL_LIMIT) {
+        size = roundUp(size);
+        return size / ALIGNMENT - 1;
+    }
+    size_t bit = highestBit(size - 1);
+    size_t step = size_t(1) << (bit - 2);
+    size = (size + step - 1) & ~(step - 1);
+    return SMALL_CLASSES + (bit - highestBit(SMALL_LIMIT)) * 4 + (size >> (bit - 2)) - 5;
+}
+
+void* allocateAligned(size_t size) {
+    return ::operator new(size, std::align_val_t(ALIGNMENT));
+}
+
+void freeAligned(void* p) {
+    ::operator delete(p, std::align_val_t(ALIGNMENT));
+}
+
+thread_local RequestArena::State* activeArena = nullptr;
+
+} // namespace
+
+struct RequestArena::State {
+    struct Chunk {
+        char* data;
+        size_t size;
+        size_t used;        // bump offset
+        size_t touched;     // highest offset ever used, for the reuse count
+        bool active;        // carved from since the last reset()
+    };
+
+    std::mutex mutex;
+    size_t chunkSize = 0;
+    std::vector<Chunk> chunks;
+    size_t cursor = 0;                          // chunk new blocks are carved from
+    std::vector<std::vector<char*>> freeBlocks; // freed blocks by size class
+    size_t liveBytes = 0;
+    uint64_t live = 0;
+    bool orphaned = false;  // the RequestArena is gone, delete with the last block
+    Stats stats;
+
+    ~State() {
+        for (Chunk& chunk : chunks) {
+            freeAligned(chunk.data);
+        }
+    }
+
+    void* allocate(size_t size) {
+        size_t needed = sizeof(BlockHeader) + std::max<size_t>(size, 1);
+        size_t sizeClass = sizeClassOf(needed);
+        std::lock_guard<std::mutex> lock(mutex);
+
+        char* block;
+        if (sizeClass < freeBlocks.size() && !freeBlocks[sizeClass].empty()) {
+            block = freeBlocks[sizeClass].back();
+            freeBlocks[sizeClass].pop_back();
+            stats.reused++;
+        } else {
+            block = carve(needed);
+        }
+        live++;
+        liveBytes += needed;
+        stats.peak = std::max(stats.peak, liveBytes);
+        stats.allocations++;
+
+        new (block) BlockHeader{this, needed, sizeClass};
+        return block + sizeof(BlockHeader);
+    }
+
+    // Returns true when this was the last block of an orphaned arena
+    bool release(BlockHeader* header) {
+        std::lock_guard<std::mutex> lock(mutex);
+        live--;
+        liveBytes -= header->size;
+        if (live == 0) {
+            rewind();
+        } else {
+            if (header->sizeClass >= freeBlocks.size()) {
+                freeBlocks.resize(header->sizeClass + 1);
+            }
+            freeBlocks[header->sizeClass].push_back(reinterpret_cast<char*>(header));
+        }
+        return orphaned && live == 0;
+    }
+
+    // Take a new block from the bump region of the chunks
+    char* carve(size_t needed) {
+        while (cursor < chunks.size() && chunks[cursor].size - chunks[cursor].used < needed) {
+            cursor++;
+        }
+        if (cursor == chunks.size()) {
+            size_t chunkBytes = std::max(chunkSize, needed);
+            chunks.push_back(Chunk{static_cast<char*>(allocateAligned(chunkBytes)), chunkBytes, 0, 0, false});
+            stats.capacity += chunkBytes;
+            stats.chunks++;
+        }
+
+        Chunk& chunk = chunks[cursor];
+        char* block = chunk.data + chunk.used;
+        if (chunk.used + needed <= chunk.touched) {
+            stats.reused++;
+        }
+        chunk.used += needed;
+        chunk.touched = std::max(chunk.touched, chunk.used);
+        chunk.active = true;
+        return block;
+    }
+
+    // With no block in use, all memory is free again: start carving from the
+    // first chunk. The free lists keep their capacity.
+    void rewind() {
+        for (Chunk& chunk : chunks) {
+            chunk.used = 0;
+        }
+        for (std::vector<char*>& blocks : freeBlocks) {
+            blocks.clear();
+        }
+        cursor = 0;
+    }
+
+    // Return the chunks at the end that nothing was carved from since the
+    // last call, so capacity follows recent requests instead of the largest
+    void trim() {
+        if (live == 0) {
+            while (!chunks.empty() && !chunks.back().active) {
+                stats.capacity -= chunks.back().size;
+                freeAligned(chunks.back().data);
+                chunks.pop_back();
+            }
+        }
+        for (Chunk& chunk : chunks) {
+            chunk.active = false;
+        }
+    }
+};
+
+RequestArena::RequestArena(size_t chunkSize)
+    : state_(new State()) {
+    state_->chunkSize = roundUp(std::max<size_t>(chunkSize, ALIGNMENT));
+}
+
+RequestArena::~RequestArena() {
+    bool destroy;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->orphaned = true;
+        destroy = state_->live == 0;
+    }
+    if (destroy) {
+        delete state_;
+    }
+}
+
+void RequestArena::reset() {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    state_->trim();
+}
+
+RequestArena::Stats RequestArena::stats() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->stats;
+}
+
+RequestArenaScope::RequestArenaScope(RequestArena& arena)
+    : previous_(activeArena) {
+    activeArena = arena.state_;
+}
+
+RequestArenaScope::~RequestArenaScope() {
+    activeArena = previous_;
+}
+
+namespace {
+
+struct ArenaOrtAllocator : OrtAllocator {
+    Ort::MemoryInfo memoryInfo{"Cpu", OrtAllocatorType::OrtDeviceAllocator, 0, OrtMemType::OrtMemTypeDefault};
+
+    ArenaOrtAllocator() : OrtAllocator{} {
+        version = ORT_API_VERSION;
+        Alloc = &allocate;
+        Free = &release;
+        Info = &info;
+#if ORT_API_VERSION >= 18
+        Reserve = &allocate;
+#endif
+    }
+
+    static void* ORT_API_CALL allocate(OrtAllocator*, size_t size) {
+        try {
+            if (RequestArena::State* arena = activeArena) {
+                return arena->allocate(size);
+            }
+            size_t needed = sizeof(BlockHeader) + roundUp(size);
+            void* block = allocateAligned(needed);
+            new (block) BlockHeader{nullptr, needed, 0};
+            return static_cast<char*>(block) + sizeof(BlockHeader);
+        } catch (const std::bad_alloc&) {
+            return nullptr;
+        }
+    }
+
+    static void ORT_API_CALL release(OrtAllocator*, void* p) {
+        if (p == nullptr) {
+            return;
+        }
+        BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<char*>(p) - sizeof(BlockHeader));
+        RequestArena::State* arena = header->arena;
+        if (arena == nullptr) {
+            freeAligned(header);
+        } else if (arena->release(header)) {
+            delete arena;
+        }
+    }
+
+    static const OrtMemoryInfo* ORT_API_CALL info(const OrtAllocator* allocator) {
+        return static_cast<const ArenaOrtAllocator*>(allocator)->memoryInfo;
+    }
+};
+
+} // namespace
+
+OrtAllocator* requestArenaAllocator() {
+    // Never destroyed, like the ModelRegistry whose Env refers to it
+    static ArenaOrtAllocator* allocator = new ArenaOrtAllocator();
+    return allocator;
+}
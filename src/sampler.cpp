@@ -0,0 +1,112 @@
+#include "sampler.h"
+#include "logits_processor.h"
+#include <algorithm>
+#include <cmath>
+
+int64_t GreedySampler::sample(const float* logits, int64_t vocabSize) {
+    return logits::argmax(logits, vocabSize);
+}
+
+std::unique_ptr<Sampler> GreedySampler::clone() const {
+    return std::make_unique<GreedySampler>();
+}
+
+StochasticSampler::StochasticSampler(const SamplingConfig& config)
+    : config(config), rng(config.seed) {}
+
+void StochasticSampler::reset() {
+    rng.seed(config.seed);
+}
+
+std::unique_ptr<Sampler> StochasticSampler::clone() const {
+    return std::make_unique<StochasticSampler>(config);
+}
+
+double StochasticSampler::uniform() {
+    return static_cast<double>(rng() >> 11) * 0x1.0p-53;
+}
+
+int64_t StochasticSampler::sample(const float* logits, int64_t vocabSize) {
+    if (vocabSize <= 0) {
+        return 0;
+    }
+
+    candidates.resize(static_cast<size_t>(vocabSize));
+    for (int64_t v = 0; v < vocabSize; v++) {
+        candidates[v] = Candidate{logits[v], 0.0f, v};
+    }
+
+    // Top-k: partial selection, the k best end up in front in no particular order
+    auto higherLogit = [](const Candidate& a, const Candidate& b) { return a.logit > b.logit; };
+    if (config.topK > 0 && config.topK < vocabSize) {
+        std::nth_element(candidates.begin(), candidates.begin() + (config.topK - 1),
+                         candidates.end(), higherLogit);
+        candidates.resize(static_cast<size_t>(config.topK));
+    }
+
+    // Softmax weights relative to the best candidate, which gets weight 1
+    auto best = std::min_element(candidates.begin(), candidates.end(), higherLogit);
+    float maxLogit = best->logit;
+    if (!std::isfinite(maxLogit)) {
+        return best->id;
+    }
+    float invTemperature = 1.0f / config.temperature;
+    double total = 0.0;
+    for (Candidate& candidate : candidates) {
+        candidate.weight = std::exp((candidate.logit - maxLogit) * invTemperature);
+        total += candidate.weight;
+    }
+
+    // Top-p: find the smallest set of most likely candidates holding topP of
+    // the mass by bisecting with nth_element. Everything before lo is kept,
+    // everything from hi on is dropped, and the cut lies in [lo, hi).
+    auto higherWeight = [](const Candidate& a, const Candidate& b) { return a.weight > b.weight; };
+    auto kept = candidates.begin();
+    auto keptEnd = candidates.end();
+    if (config.topP < 1.0f) {
+        double target = config.topP * total;
+        double above = 0.0;
+        auto lo = candidates.begin();
+        auto hi = candidates.end();
+        while (hi - lo > 1) {
+            auto mid = lo + (hi - lo) / 2;
+            std::nth_element(lo, mid, hi, higherWeight);
+            double mass = 0.0;
+            for (auto it = lo; it != mid; ++it) mass += it->weight;
+            if (above + mass >= target) {
+                hi = mid;
+            } else {
+                above += mass;
+                lo = mid;
+            }
+        }
+        keptEnd = hi;
+    }
+
+    // Min-p: drop kept candidates below minP of the best one (weight 1)
+    if (config.minP > 0.0f) {
+        float minWeight = std::min(config.minP, 1.0f);
+        keptEnd = std::partition(kept, keptEnd,
+            [minWeight](const Candidate& c) { return c.weight >= minWeight; });
+    }
+
+    total = 0.0;
+    for (auto it = kept; it != keptEnd; ++it) total += it->weight;
+
+    // Draw from the kept candidates in proportion to their weights
+    double threshold = uniform() * total;
+    for (auto it = kept; it != keptEnd; ++it) {
+        threshold -= it->weight;
+        if (threshold < 0.0) {
+            return it->id;
+        }
+    }
+    return (keptEnd - 1)->id;
+}
+
+std::unique_ptr<Sampler> createSampler(const SamplingConfig& config) {
+    if (config.temperature <= 0.0f || config.topK == 1) {
+        return std::make_unique<GreedySampler>();
+    }
+    return std::make_unique<StochasticSampler>(config);
+}
@@ -0,0 +1,70 @@
+#include "streaming_vocoder.h"
+#include <algorithm>
+#include <cmath>
+
+StreamingVocoder::StreamingVocoder(const StreamingOptions& options, DecodeFunction decode, AudioSink sink)
+    : options_(options), decode_(std::move(decode)), sink_(std::move(sink)) {
+    options_.chunkTokens = std::max(options_.chunkTokens, 1);
+    options_.lookaheadTokens = std::max(options_.lookaheadTokens, 0);
+    options_.contextTokens = std::max(options_.contextTokens, 0);
+    options_.crossfadeSamples = std::max(options_.crossfadeSamples, 0);
+}
+
+bool StreamingVocoder::push(const std::vector<int64_t>& tokens) {
+    tokens_.insert(tokens_.end(), tokens.begin(), tokens.end());
+
+    size_t window = static_cast<size_t>(options_.chunkTokens + options_.lookaheadTokens);
+    while (!cancelled_ && tokens_.size() >= committed_ + window) {
+        decodeChunk(committed_ + options_.chunkTokens, false);
+    }
+    return !cancelled_;
+}
+
+bool StreamingVocoder::finish() {
+    if (!cancelled_ && !finished_) {
+        decodeChunk(tokens_.size(), true);
+        finished_ = true;
+    }
+    return !cancelled_;
+}
+
+void StreamingVocoder::decodeChunk(size_t chunkEnd, bool isFinal) {
+    size_t contextStart = committed_ - std::min(committed_, static_cast<size_t>(options_.contextTokens));
+    size_t windowEnd = isFinal ? tokens_.size() : chunkEnd + options_.lookaheadTokens;
+
+    std::vector<int64_t> window(tokens_.begin() + contextStart, tokens_.begin() + windowEnd);
+    std::vector<float> audio = decode_(window, isFinal);
+
+    // The final window carries trailing padding, so the token rate is taken
+    // from regular windows whenever one has been decoded
+    if (!isFinal || samplesPerToken_ == 0.0) {
+        samplesPerToken_ = window.empty() ? 0.0 : double(audio.size()) / double(window.size());
+    }
+
+    auto sampleAt = [&](size_t token) {
+        size_t sample = static_cast<size_t>(std::llround(double(token - contextStart) * samplesPerToken_));
+        return std::min(sample, audio.size());
+    };
+
+    size_t begin = sampleAt(committed_);
+    size_t end = isFinal ? audio.size() : sampleAt(chunkEnd);
+    std::vector<float> chunk(audio.begin() + begin, audio.begin() + end);
+
+    // Overlap-add the tail decoded with the previous chunk
+    size_t fade = std::min(tail_.size(), chunk.size());
+    for (size_t k = 0; k < fade; k++) {
+        float w = float(k + 1) / float(fade + 1);
+        chunk[k] = tail_[k] * (1.0f - w) + chunk[k] * w;
+    }
+
+    tail_.clear();
+    if (!isFinal) {
+        size_t tailEnd = std::min(end + static_cast<size_t>(options_.crossfadeSamples), audio.size());
+        tail_.assign(audio.begin() + end, audio.begin() + tailEnd);
+    }
+
+    committed_ = chunkEnd;
+    if (!sink_(chunk, isFinal)) {
+        cancelled_ = true;
+    }
+}
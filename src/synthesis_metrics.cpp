@@ -0,0 +1,73 @@
+#include "synthesis_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Nearest-rank percentile
+double percentile(std::vector<double>& samples, double fraction) {
+    size_t rank = static_cast<size_t>(std::ceil(fraction * samples.size()));
+    auto nth = samples.begin() + (std::max<size_t>(rank, 1) - 1);
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+} // namespace
+
+void SynthesisMetrics::setDecodeSteps(std::vector<double>& stepMs) {
+    decodeSteps = static_cast<int>(stepMs.size());
+    decodeMs = 0.0;
+    for (double ms : stepMs) decodeMs += ms;
+    if (stepMs.empty()) {
+        decodeStepP50Ms = 0.0;
+        decodeStepP99Ms = 0.0;
+        return;
+    }
+    decodeStepP50Ms = percentile(stepMs, 0.50);
+    decodeStepP99Ms = percentile(stepMs, 0.99);
+}
+
+void SynthesisMetrics::finish(double requestMs) {
+    totalMs = requestMs;
+    double generationMs = prefillMs + decodeMs;
+    tokensPerSecond = generationMs > 0.0 ? speechTokens * 1000.0 / generationMs : 0.0;
+    realTimeFactor = audioSeconds > 0.0 ? totalMs / 1000.0 / audioSeconds : 0.0;
+}
+
+std::string SynthesisMetrics::toJson() const {
+    json line = {
+        {"tokenize_ms", tokenizeMs},
+        {"prefill_ms", prefillMs},
+        {"decode_steps", decodeSteps},
+        {"decode_ms", decodeMs},
+        {"decode_step_p50_ms", decodeStepP50Ms},
+        {"decode_step_p99_ms", decodeStepP99Ms},
+        {"vocoder_ms", vocoderMs},
+        {"pcm_ms", pcmMs},
+        {"speech_tokens", speechTokens},
+        {"tokens_per_s", tokensPerSecond},
+        {"ttft_ms", timeToFirstTokenMs},
+        {"ttfa_ms", timeToFirstAudioMs},
+        {"audio_s", audioSeconds},
+        {"total_ms", totalMs},
+        {"rtf", realTimeFactor},
+    };
+    return line.dump();
+}
+
+bool appendMetricsLine(const std::string& path, const SynthesisMetrics& metrics) {
+    static std::mutex mutex;
+    std::string line = metrics.toJson();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << line << '\n';
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,37 @@
+#include "token_stream_decoder.hpp"
+#include "bpe_tokenizer.hpp"
+#include "utf8.hpp"
+#include <cstring>
+
+TokenStreamDecoder::TokenStreamDecoder(const BPETokenizer& tokenizer, bool skip_special_tokens)
+    : tables(tokenizer.tables),
+      skip_id(skip_special_tokens ? tokenizer.eos_token_id : -1) {
+}
+
+size_t TokenStreamDecoder::push(int64_t id, std::string& text) {
+    if (!tables || (skip_id >= 0 && id == skip_id)) {
+        return 0;
+    }
+
+    size_t start = text.size();
+    text.append(pending, pending_size);
+    text += tables->tokenBytes(id);
+
+    // Keep a trailing partial character for the next token
+    pending_size = unicode::incompleteUtf8Suffix(text.data() + start, text.size() - start);
+    std::memcpy(pending, text.data() + text.size() - pending_size, pending_size);
+    text.resize(text.size() - pending_size);
+    return text.size() - start;
+}
+
+std::string TokenStreamDecoder::push(int64_t id) {
+    std::string text;
+    push(id, text);
+    return text;
+}
+
+std::string TokenStreamDecoder::finish() {
+    std::string text(pending, pending_size);
+    pending_size = 0;
+    return text;
+}
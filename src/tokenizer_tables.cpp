@@ -0,0 +1,322 @@
+#include "tokenizer_tables.hpp"
+#include "utf8.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'B', 'X', 'T', 'O', 'K', 'E', 'N'};
+constexpr uint32_t FORMAT_VERSION = 2;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t id_count;
+    uint32_t vocab_count;
+    uint32_t merge_count;
+    uint32_t merge_slot_count;
+    uint32_t added_count;
+    uint32_t reserved;
+    uint64_t string_bytes;
+    uint64_t raw_bytes;
+    uint64_t offsets_at;
+    uint64_t sorted_at;
+    uint64_t merges_at;
+    uint64_t added_at;
+    uint64_t byte_ids_at;
+    uint64_t strings_at;
+    uint64_t raw_offsets_at;
+    uint64_t raw_at;
+    uint64_t total_size;
+};
+
+static_assert(sizeof(Header) % 8 == 0, "sections after the header must stay aligned");
+static_assert(sizeof(BPEMergeTable::Slot) == 16, "merge slot layout is part of the file format");
+
+size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+// True if [at, at + bytes) lies inside a blob of size bytes and is 8-byte aligned
+bool sectionFits(uint64_t at, uint64_t bytes, size_t size) {
+    return at % 8 == 0 && at <= size && bytes <= size - at;
+}
+
+} // namespace
+
+std::shared_ptr<const TokenizerTables> TokenizerTables::build(
+    const std::vector<std::pair<std::string, int64_t>>& tokens,
+    const std::vector<std::pair<std::string, std::string>>& merges,
+    const std::vector<int64_t>& added_ids,
+    const std::array<std::string, 256>& byte_symbols) {
+
+    // String -> ID in byte order, later entries win
+    std::map<std::string_view, int64_t> by_string;
+    int64_t max_id = -1;
+    for (const auto& [token, id] : tokens) {
+        if (id < 0 || id >= INT32_MAX) {
+            std::cerr << "Error: Token ID out of range: " << id << std::endl;
+            return nullptr;
+        }
+        by_string[token] = id;
+        max_id = std::max(max_id, id);
+    }
+    size_t id_count = static_cast<size_t>(max_id + 1);
+
+    std::vector<const std::string*> by_id(id_count, nullptr);
+    for (const auto& [token, id] : tokens) {
+        by_id[id] = &token;
+    }
+
+    auto lookup = [&](const std::string& token) -> int32_t {
+        auto it = by_string.find(token);
+        return it == by_string.end() ? -1 : static_cast<int32_t>(it->second);
+    };
+
+    // Merges by ID; merges over unknown tokens can never apply
+    BPEMergeTable merge_table;
+    merge_table.reset(merges.size());
+    for (size_t i = 0; i < merges.size(); i++) {
+        int32_t left = lookup(merges[i].first);
+        int32_t right = lookup(merges[i].second);
+        int32_t merged = lookup(merges[i].first + merges[i].second);
+        if (left < 0 || right < 0 || merged < 0) {
+            continue;
+        }
+        merge_table.insert(left, right, static_cast<int32_t>(i), merged);
+    }
+
+    std::vector<uint32_t> added;
+    for (int64_t id : added_ids) {
+        if (id < 0 || static_cast<size_t>(id) >= id_count) {
+            std::cerr << "Error: Added token ID out of range: " << id << std::endl;
+            return nullptr;
+        }
+        added.push_back(static_cast<uint32_t>(id));
+    }
+
+    // Byte of each byte-level symbol code point, to decode tokens to raw bytes
+    std::unordered_map<char32_t, char> symbol_bytes;
+    for (int b = 0; b < 256; b++) {
+        const std::string& symbol = byte_symbols[b];
+        char32_t cp;
+        if (!symbol.empty() &&
+            unicode::decodeUtf8(symbol.data(), symbol.data() + symbol.size(), cp) == symbol.size()) {
+            symbol_bytes[cp] = static_cast<char>(b);
+        }
+    }
+    std::vector<std::string> raw(id_count);
+    for (size_t id = 0; id < id_count; id++) {
+        if (by_id[id] == nullptr) continue;
+        const char* p = by_id[id]->data();
+        const char* end = p + by_id[id]->size();
+        while (p < end) {
+            char32_t cp;
+            p += unicode::decodeUtf8(p, end, cp);
+            auto it = symbol_bytes.find(cp);
+            if (it != symbol_bytes.end()) {
+                raw[id].push_back(it->second);
+            }
+        }
+    }
+    // Added tokens are not byte-level encoded and decode to their own text
+    for (uint32_t id : added) {
+        if (by_id[id] != nullptr) raw[id] = *by_id[id];
+    }
+
+    size_t string_bytes = 0;
+    size_t raw_bytes = 0;
+    for (size_t id = 0; id < id_count; id++) {
+        if (by_id[id] != nullptr) string_bytes += by_id[id]->size();
+        raw_bytes += raw[id].size();
+    }
+    if (string_bytes > UINT32_MAX || raw_bytes > UINT32_MAX) {
+        std::cerr << "Error: Vocabulary too large" << std::endl;
+        return nullptr;
+    }
+
+    // Lay out the sections
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.id_count = static_cast<uint32_t>(id_count);
+    header.vocab_count = static_cast<uint32_t>(by_string.size());
+    header.merge_count = static_cast<uint32_t>(merge_table.size());
+    header.merge_slot_count = static_cast<uint32_t>(merge_table.slotCount());
+    header.added_count = static_cast<uint32_t>(added.size());
+    header.string_bytes = string_bytes;
+    header.raw_bytes = raw_bytes;
+
+    size_t at = sizeof(Header);
+    header.offsets_at = at;
+    at = align8(at + (id_count + 1) * sizeof(uint32_t));
+    header.sorted_at = at;
+    at = align8(at + by_string.size() * sizeof(uint32_t));
+    header.merges_at = at;
+    at = align8(at + merge_table.slotCount() * sizeof(BPEMergeTable::Slot));
+    header.added_at = at;
+    at = align8(at + added.size() * sizeof(uint32_t));
+    header.byte_ids_at = at;
+    at = align8(at + 256 * sizeof(int32_t));
+    header.strings_at = at;
+    at = align8(at + string_bytes);
+    header.raw_offsets_at = at;
+    at = align8(at + (id_count + 1) * sizeof(uint32_t));
+    header.raw_at = at;
+    at = align8(at + raw_bytes);
+    header.total_size = at;
+
+    std::shared_ptr<TokenizerTables> tables(new TokenizerTables());
+    tables->owned.assign(at / sizeof(uint64_t), 0);
+    char* blob = reinterpret_cast<char*>(tables->owned.data());
+    std::memcpy(blob, &header, sizeof(Header));
+
+    uint32_t* offsets = reinterpret_cast<uint32_t*>(blob + header.offsets_at);
+    char* strings = blob + header.strings_at;
+    uint32_t offset = 0;
+    for (size_t id = 0; id < id_count; id++) {
+        offsets[id] = offset;
+        if (by_id[id] != nullptr) {
+            std::memcpy(strings + offset, by_id[id]->data(), by_id[id]->size());
+            offset += static_cast<uint32_t>(by_id[id]->size());
+        }
+    }
+    offsets[id_count] = offset;
+
+    uint32_t* raw_offsets = reinterpret_cast<uint32_t*>(blob + header.raw_offsets_at);
+    char* raw_data = blob + header.raw_at;
+    offset = 0;
+    for (size_t id = 0; id < id_count; id++) {
+        raw_offsets[id] = offset;
+        std::memcpy(raw_data + offset, raw[id].data(), raw[id].size());
+        offset += static_cast<uint32_t>(raw[id].size());
+    }
+    raw_offsets[id_count] = offset;
+
+    uint32_t* sorted = reinterpret_cast<uint32_t*>(blob + header.sorted_at);
+    for (const auto& entry : by_string) {
+        *sorted++ = static_cast<uint32_t>(entry.second);
+    }
+
+    std::memcpy(blob + header.merges_at, merge_table.data(),
+                merge_table.slotCount() * sizeof(BPEMergeTable::Slot));
+    if (!added.empty()) {
+        std::memcpy(blob + header.added_at, added.data(), added.size() * sizeof(uint32_t));
+    }
+
+    int32_t* byte_ids = reinterpret_cast<int32_t*>(blob + header.byte_ids_at);
+    for (int b = 0; b < 256; b++) {
+        byte_ids[b] = lookup(byte_symbols[b]);
+    }
+
+    if (!tables->attach(blob, at)) {
+        std::cerr << "Error: Built tokenizer tables are inconsistent" << std::endl;
+        return nullptr;
+    }
+    return tables;
+}
+
+std::shared_ptr<const TokenizerTables> TokenizerTables::map(const std::string& filepath) {
+    std::shared_ptr<TokenizerTables> tables(new TokenizerTables());
+    if (!tables->file.open(filepath)) {
+        std::cerr << "Error: Cannot open compiled tokenizer: " << filepath << std::endl;
+        return nullptr;
+    }
+    if (!tables->attach(static_cast<const char*>(tables->file.data()), tables->file.size())) {
+        std::cerr << "Error: Invalid compiled tokenizer: " << filepath << std::endl;
+        return nullptr;
+    }
+    return tables;
+}
+
+bool TokenizerTables::save(const std::string& filepath) const {
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot write compiled tokenizer: " << filepath << std::endl;
+        return false;
+    }
+    file.write(blob, static_cast<std::streamsize>(blob_size));
+    return static_cast<bool>(file);
+}
+
+bool TokenizerTables::attach(const char* data, size_t size) {
+    if (size < sizeof(Header)) return false;
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != FORMAT_VERSION || header.byte_order != BYTE_ORDER_MARK ||
+        header.total_size != size) {
+        return false;
+    }
+
+    if (!sectionFits(header.offsets_at, (uint64_t(header.id_count) + 1) * sizeof(uint32_t), size) ||
+        !sectionFits(header.sorted_at, uint64_t(header.vocab_count) * sizeof(uint32_t), size) ||
+        !sectionFits(header.merges_at, uint64_t(header.merge_slot_count) * sizeof(BPEMergeTable::Slot), size) ||
+        !sectionFits(header.added_at, uint64_t(header.added_count) * sizeof(uint32_t), size) ||
+        !sectionFits(header.byte_ids_at, 256 * sizeof(int32_t), size) ||
+        !sectionFits(header.strings_at, header.string_bytes, size) ||
+        !sectionFits(header.raw_offsets_at, (uint64_t(header.id_count) + 1) * sizeof(uint32_t), size) ||
+        !sectionFits(header.raw_at, header.raw_bytes, size)) {
+        return false;
+    }
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(data + header.offsets_at);
+    const uint32_t* sorted = reinterpret_cast<const uint32_t*>(data + header.sorted_at);
+    const uint32_t* added = reinterpret_cast<const uint32_t*>(data + header.added_at);
+    const int32_t* bytes = reinterpret_cast<const int32_t*>(data + header.byte_ids_at);
+    const uint32_t* raw_offsets = reinterpret_cast<const uint32_t*>(data + header.raw_offsets_at);
+
+    // Bounds checks only; every later access can then index without checking
+    if (offsets[0] != 0 || offsets[header.id_count] != header.string_bytes) return false;
+    if (raw_offsets[0] != 0 || raw_offsets[header.id_count] != header.raw_bytes) return false;
+    for (uint32_t id = 0; id < header.id_count; id++) {
+        if (offsets[id] > offsets[id + 1] || raw_offsets[id] > raw_offsets[id + 1]) return false;
+    }
+    for (uint32_t i = 0; i < header.vocab_count; i++) {
+        if (sorted[i] >= header.id_count) return false;
+    }
+    for (uint32_t i = 0; i < header.added_count; i++) {
+        if (added[i] >= header.id_count) return false;
+    }
+    for (int b = 0; b < 256; b++) {
+        if (bytes[b] < -1 || bytes[b] >= static_cast<int64_t>(header.id_count)) return false;
+    }
+    // Token strings come from JSON and are always UTF-8
+    if (!unicode::isValidUtf8(data + header.strings_at, header.string_bytes)) return false;
+    if (!merge_table.attach(reinterpret_cast<const BPEMergeTable::Slot*>(data + header.merges_at),
+                            header.merge_slot_count, header.merge_count)) {
+        return false;
+    }
+
+    blob = data;
+    blob_size = size;
+    id_count = header.id_count;
+    vocab_count = header.vocab_count;
+    added_count = header.added_count;
+    token_offsets = offsets;
+    sorted_ids = sorted;
+    added_ids = added;
+    byte_ids = bytes;
+    token_data = data + header.strings_at;
+    raw_token_offsets = raw_offsets;
+    raw_token_data = data + header.raw_at;
+    return true;
+}
+
+int64_t TokenizerTables::find(std::string_view token) const {
+    const uint32_t* end = sorted_ids + vocab_count;
+    const uint32_t* it = std::lower_bound(sorted_ids, end, token,
+        [this](uint32_t id, std::string_view value) { return this->token(id) < value; });
+    if (it != end && this->token(*it) == token) {
+        return *it;
+    }
+    return -1;
+}
@@ -0,0 +1,53 @@
+#include "utf8.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define UTF8_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define UTF8_NEON 1
+#endif
+
+namespace {
+
+// True if all 16 bytes at p are ASCII
+inline bool asciiBlock(const char* p) {
+#if defined(UTF8_SSE2)
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    return _mm_movemask_epi8(block) == 0;
+#elif defined(UTF8_NEON)
+    uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+    return vmaxvq_u8(block) < 0x80;
+#else
+    for (int i = 0; i < 16; i++) {
+        if (static_cast<unsigned char>(p[i]) >= 0x80) return false;
+    }
+    return true;
+#endif
+}
+
+} // namespace
+
+namespace unicode {
+
+size_t validUtf8Prefix(const char* data, size_t size) {
+    const char* end = data + size;
+    const char* p = data;
+    while (p < end) {
+        if (end - p >= 16 && asciiBlock(p)) {
+            p += 16;
+            continue;
+        }
+
+        char32_t cp;
+        size_t length = decodeUtf8(p, end, cp);
+        // decodeUtf8 reports errors as a one-byte U+FFFD; a literal U+FFFD is three bytes
+        if (cp == 0xFFFD && length == 1) {
+            break;
+        }
+        p += length;
+    }
+    return static_cast<size_t>(p - data);
+}
+
+} // namespace unicode
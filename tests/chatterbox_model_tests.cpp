@@ -0,0 +1,210 @@
+// Checks of ChatterBox internals that need the exported models.
+//
+// Usage: chatterbox_model_tests <ModelDir> <StyleDir> <tokenizer.json> [config.json]
+//
+// embedding_table: every row of the speech embedding table extracted at load
+// time is bit-identical to what a 1x1 embed_tokens.onnx run returns for that
+// id, the per-step path the table replaced.
+//
+// decode_step_allocations: after a warm-up request, counts the operator new
+// calls on the decoding thread inside the ChatterBox::decodeStepProbe brackets,
+// which cover every decode step except languageModel->Run itself.
+//   host: buffer setup, embedding lookup, token selection and bookkeeping
+//     must make no heap allocations.
+//   binding: rebinding the language model inputs and outputs still allocates
+//     inside ONNX Runtime. Each of the 100 bound tensors (inputs_embeds,
+//     attention_mask, position_ids, logits and the 48 past and 48 present KV
+//     tensors) gets a new OrtValue from Ort::Value::CreateTensor, as the KV
+//     shapes change every step, and IoBinding::BindInput/BindOutput copies its
+//     name and value after ClearBoundInputs/ClearBoundOutputs. These must be
+//     the same count on every step, so nothing grows with the sequence length.
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+#include "chatterbox.h"
+
+namespace {
+
+thread_local bool countingAllocations = false;
+thread_local uint64_t probedAllocations = 0;
+
+void* countedAllocate(std::size_t size, std::size_t alignment) {
+    if (countingAllocations) {
+        probedAllocations++;
+    }
+    size = size == 0 ? 1 : size;
+    void* p = alignment > alignof(std::max_align_t)
+        ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+        : std::malloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    return countedAllocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+struct ChatterBoxTestAccess {
+    using DecodeStepPhase = ChatterBox::DecodeStepPhase;
+
+    static void setDecodeStepProbe(ChatterBox& chatterbox, void (*probe)(DecodeStepPhase, bool)) {
+        chatterbox.decodeStepProbe = probe;
+    }
+
+    static bool hasEmbeddingTable(const ChatterBox& chatterbox) {
+        return chatterbox.speechEmbeddingTable && !chatterbox.speechEmbeddingTable->empty();
+    }
+
+    // Embedding of a speech token from the table, or from embed_tokens.onnx
+    static void embedSpeechToken(ChatterBox& chatterbox, int64_t tokenId, float* dst, bool fromTable) {
+        bool useTable = chatterbox.useEmbeddingTable;
+        chatterbox.useEmbeddingTable = fromTable;
+        chatterbox.embedSpeechToken(tokenId, dst);
+        chatterbox.useEmbeddingTable = useTable;
+    }
+};
+
+namespace {
+
+uint64_t hostAllocations = 0;
+// Allocations of each step's binding phase, reserved before the measured request
+std::vector<uint64_t> bindingAllocations;
+
+void countDecodeStep(ChatterBoxTestAccess::DecodeStepPhase phase, bool active) {
+    countingAllocations = active;
+    if (active) {
+        probedAllocations = 0;
+        return;
+    }
+    if (phase == ChatterBoxTestAccess::DecodeStepPhase::Host) {
+        hostAllocations += probedAllocations;
+    } else {
+        bindingAllocations.push_back(probedAllocations);
+    }
+}
+
+bool checkEmbeddingTable(ChatterBox& chatterbox) {
+    if (!ChatterBoxTestAccess::hasEmbeddingTable(chatterbox)) {
+        std::cerr << "embedding_table: no table was extracted" << std::endl;
+        return false;
+    }
+
+    std::vector<float> tableRow(chatterbox.HIDDEN_SIZE);
+    std::vector<float> sessionRow(chatterbox.HIDDEN_SIZE);
+    int64_t mismatches = 0;
+    for (int64_t id = 0; id < chatterbox.SPEECH_VOCAB_SIZE; id++) {
+        ChatterBoxTestAccess::embedSpeechToken(chatterbox, id, tableRow.data(), true);
+        ChatterBoxTestAccess::embedSpeechToken(chatterbox, id, sessionRow.data(), false);
+        if (std::memcmp(tableRow.data(), sessionRow.data(), tableRow.size() * sizeof(float)) != 0) {
+            if (mismatches == 0) {
+                std::cerr << "embedding_table: row " << id << " differs from embed_tokens.onnx" << std::endl;
+            }
+            mismatches++;
+        }
+    }
+    std::cout << "embedding_table: " << chatterbox.SPEECH_VOCAB_SIZE << " rows, "
+              << mismatches << " differ" << std::endl;
+    return mismatches == 0;
+}
+
+bool checkDecodeStepAllocations(ChatterBox& chatterbox, const std::vector<int64_t>& inputIds) {
+    // Grows every buffer the decode loop reuses
+    std::vector<int64_t> warmUp = chatterbox.SynthesizeSpeechTokens(inputIds);
+
+    hostAllocations = 0;
+    bindingAllocations.clear();
+    bindingAllocations.reserve(warmUp.size() + 1);
+    ChatterBoxTestAccess::setDecodeStepProbe(chatterbox, &countDecodeStep);
+    std::vector<int64_t> tokens = chatterbox.SynthesizeSpeechTokens(inputIds);
+    ChatterBoxTestAccess::setDecodeStepProbe(chatterbox, nullptr);
+
+    if (bindingAllocations.empty()) {
+        std::cerr << "decode_step_allocations: no decode step ran" << std::endl;
+        return false;
+    }
+    uint64_t bindingMin = bindingAllocations.front();
+    uint64_t bindingMax = bindingAllocations.front();
+    for (uint64_t count : bindingAllocations) {
+        bindingMin = std::min(bindingMin, count);
+        bindingMax = std::max(bindingMax, count);
+    }
+    std::cout << "decode_step_allocations: " << bindingAllocations.size() << " decode steps, host "
+              << hostAllocations << " allocations, binding " << bindingMin;
+    if (bindingMax != bindingMin) {
+        std::cout << ".." << bindingMax;
+    }
+    std::cout << " allocations per step inside ONNX Runtime" << std::endl;
+    if (hostAllocations != 0) {
+        std::cerr << "decode_step_allocations: the host-side work allocated" << std::endl;
+    }
+    if (bindingMax != bindingMin) {
+        std::cerr << "decode_step_allocations: binding allocations vary between steps" << std::endl;
+    }
+    return hostAllocations == 0 && bindingMax == bindingMin;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <ModelDir> <StyleDir> <tokenizer.json> [config.json]" << std::endl;
+        return 1;
+    }
+
+    ChatterBoxConfig config;
+    if (argc > 4 && !config.loadFromFile(argv[4])) {
+        return 1;
+    }
+
+    BPETokenizer tokenizer;
+    if (!tokenizer.loadFromFile(argv[3])) {
+        return 1;
+    }
+    std::vector<int64_t> inputIds = tokenizer.encode("Hello, welcome to my world!", true);
+
+    ChatterBox chatterbox(argv[1], config);
+    chatterbox.LoadStyle(argv[2]);
+    // The same tokens every request, so the measured request is no longer than the warm-up
+    chatterbox.setSampler(std::make_unique<GreedySampler>());
+
+    int failures = 0;
+    if (!checkEmbeddingTable(chatterbox)) {
+        std::cerr << "FAILED: embedding_table" << std::endl;
+        failures++;
+    }
+    if (!checkDecodeStepAllocations(chatterbox, inputIds)) {
+        std::cerr << "FAILED: decode_step_allocations" << std::endl;
+        failures++;
+    }
+    return failures == 0 ? 0 : 1;
+}
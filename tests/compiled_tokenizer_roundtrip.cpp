@@ -0,0 +1,93 @@
+// Checks that a compiled tokenizer behaves exactly like the tokenizer.json it
+// was compiled from, so a change to the blob format cannot regress silently.
+//
+// Usage: compiled_tokenizer_roundtrip <tokenizer.json> <corpus dir> <output.bin>
+//
+// tokenizer.json is compiled to output.bin and loaded back. Both tokenizers
+// must have the same table sizes, decode every ID the same, and give the same
+// IDs and decoded text for every line of every file in the corpus directory.
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+
+namespace {
+
+std::vector<std::string> loadCorpus(const std::string& directory) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> texts;
+    for (const auto& file : files) {
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            texts.push_back(line);
+        }
+    }
+    return texts;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <tokenizer.json> <corpus dir> <output.bin>" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> texts = loadCorpus(argv[2]);
+    if (texts.empty()) {
+        std::cerr << "No texts in " << argv[2] << std::endl;
+        return 1;
+    }
+
+    BPETokenizer fromJson;
+    if (!fromJson.loadFromFile(argv[1]) || !fromJson.saveCompiled(argv[3])) {
+        return 1;
+    }
+    BPETokenizer compiled;
+    if (!compiled.loadCompiled(argv[3])) {
+        return 1;
+    }
+
+    if (fromJson.vocabSize() != compiled.vocabSize() ||
+        fromJson.mergeCount() != compiled.mergeCount() ||
+        fromJson.addedTokenCount() != compiled.addedTokenCount()) {
+        std::cerr << "Table sizes differ" << std::endl;
+        return 1;
+    }
+
+    size_t failures = 0;
+    int64_t maxId = static_cast<int64_t>(fromJson.vocabSize()) + 1024;
+    for (int64_t id = 0; id < maxId; id++) {
+        if (fromJson.decode({id}, false) != compiled.decode({id}, false)) {
+            if (failures++ == 0) {
+                std::cerr << "Token " << id << " decodes differently" << std::endl;
+            }
+        }
+    }
+
+    for (const std::string& text : texts) {
+        for (bool addSpecialTokens : {false, true}) {
+            std::vector<int64_t> expected = fromJson.encode(text, addSpecialTokens);
+            std::vector<int64_t> actual = compiled.encode(text, addSpecialTokens);
+            if (actual != expected || compiled.decode(actual, true) != fromJson.decode(expected, true)) {
+                if (failures++ == 0) {
+                    std::cerr << "Encoding differs for: " << text << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << texts.size() << " texts, " << maxId << " token IDs: " << failures << " differences" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
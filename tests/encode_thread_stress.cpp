@@ -0,0 +1,141 @@
+// Stress test of BPETokenizer::encode from several threads sharing one
+// tokenizer whose word cache is too small for the corpus.
+//
+// Usage: encode_thread_stress <tokenizer.json|tokenizer.bin> <corpus dir> [--threads N] [--passes N] [--cache N]
+//
+// Every line of every file in the corpus directory is one text. The expected
+// IDs come from serial encode calls on a second tokenizer without a cache.
+// Each thread then encodes all texts --passes times, starting at a different
+// offset, so lookups, insertions and evictions of the shared cache race.
+// encodeBatch on a thread pool is checked the same way.
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+
+namespace {
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() &&
+           text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool loadTokenizer(BPETokenizer& tokenizer, const std::string& path) {
+    return endsWith(path, ".json") ? tokenizer.loadFromFile(path) : tokenizer.loadCompiled(path);
+}
+
+std::vector<std::string> loadCorpus(const std::string& directory) {
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> texts;
+    for (const auto& file : files) {
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                texts.push_back(line);
+            }
+        }
+    }
+    return texts;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <tokenizer.json|tokenizer.bin> <corpus dir> [--threads N] [--passes N] [--cache N]"
+                  << std::endl;
+        return 1;
+    }
+
+    size_t threadCount = 8;
+    size_t passes = 4;
+    size_t cacheEntries = 64;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--threads") {
+            threadCount = std::max<size_t>(std::stoul(argv[i + 1]), 2);
+        } else if (option == "--passes") {
+            passes = std::stoul(argv[i + 1]);
+        } else if (option == "--cache") {
+            cacheEntries = std::stoul(argv[i + 1]);
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::string> texts = loadCorpus(argv[2]);
+    if (texts.empty()) {
+        std::cerr << "No texts in " << argv[2] << std::endl;
+        return 1;
+    }
+
+    BPETokenizer reference;
+    BPETokenizer tokenizer;
+    if (!loadTokenizer(reference, argv[1]) || !loadTokenizer(tokenizer, argv[1])) {
+        return 1;
+    }
+    reference.setCacheCapacity(0);
+    tokenizer.setCacheCapacity(cacheEntries);
+
+    std::vector<std::vector<int64_t>> expected;
+    expected.reserve(texts.size());
+    for (const std::string& text : texts) {
+        expected.push_back(reference.encode(text, true));
+    }
+
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            size_t start = t * texts.size() / threadCount;
+            for (size_t pass = 0; pass < passes; pass++) {
+                for (size_t n = 0; n < texts.size(); n++) {
+                    size_t i = (start + n) % texts.size();
+                    if (tokenizer.encode(texts[i], true) != expected[i]) {
+                        mismatches++;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    tokenizer.setThreadCount(threadCount);
+    EncodedBatch batch = tokenizer.encodeBatch(texts, true);
+    for (size_t i = 0; i < texts.size(); i++) {
+        if (batch.sequence(i) != expected[i]) {
+            mismatches++;
+        }
+    }
+
+    BPEWordCache::Stats stats = tokenizer.cacheStats();
+    std::cout << texts.size() << " texts, " << threadCount << " threads: " << mismatches.load()
+              << " mismatches, " << stats.hits << " hits, " << stats.misses << " misses, "
+              << stats.evictions << " evictions" << std::endl;
+
+    if (mismatches > 0) {
+        return 1;
+    }
+    if (cacheEntries > 0 && stats.evictions == 0) {
+        std::cerr << "The cache never evicted; use a smaller --cache" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Differential test of PreTokenizer against the std::regex pre-tokenizer it
+// replaced, on generated ASCII text.
+//
+// Usage: pre_tokenizer_diff [--cases N] [--seed N]
+//
+// On ASCII the GPT-2 pattern's \p{L} and \p{N} are [a-zA-Z] and [0-9], so the
+// old std::regex pattern must split every input exactly like the scanner.
+// '_' is left out of the generated text: it is in \w, so no alternative of the
+// old pattern matched it and the regex silently dropped it, while GPT-2 (and
+// the scanner) keep it as punctuation.
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "pre_tokenizer.hpp"
+
+namespace {
+
+const std::regex REFERENCE_PATTERN(
+    R"('s|'t|'re|'ve|'m|'ll|'d| ?[a-zA-Z]+| ?[0-9]+| ?[^\s\w]+|\s+(?!\S)|\s+)");
+
+std::vector<std::string> splitReference(const std::string& text) {
+    std::vector<std::string> pieces;
+    for (std::sregex_iterator it(text.begin(), text.end(), REFERENCE_PATTERN), end; it != end; ++it) {
+        pieces.push_back(it->str());
+    }
+    return pieces;
+}
+
+std::vector<std::string> splitScanner(const std::string& text) {
+    std::vector<std::string> pieces;
+    PreTokenizer splitter(text);
+    std::string_view piece;
+    while (splitter.next(piece)) {
+        pieces.emplace_back(piece);
+    }
+    return pieces;
+}
+
+void printPieces(const char* label, const std::vector<std::string>& pieces) {
+    std::cerr << "  " << label << ":";
+    for (const std::string& piece : pieces) {
+        std::cerr << " [" << piece << "]";
+    }
+    std::cerr << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long cases = 200000;
+    unsigned seed = 42;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        if (option == "--cases") {
+            cases = std::stol(argv[i + 1]);
+        } else if (option == "--seed") {
+            seed = static_cast<unsigned>(std::stoul(argv[i + 1]));
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
+
+    // Half the cases draw from a small alphabet rich in contractions and
+    // whitespace runs, the rest from all of ASCII but NUL and '_'
+    const std::string dense = "abcXYZ019 \t\n\r\v\f'!?.,-\"srtvelmd  ";
+    std::string ascii;
+    for (int c = 1; c < 128; c++) {
+        if (c != '_') {
+            ascii += static_cast<char>(c);
+        }
+    }
+
+    std::mt19937 rng(seed);
+    for (long n = 0; n < cases; n++) {
+        const std::string& alphabet = n % 2 == 0 ? dense : ascii;
+        std::string text;
+        size_t length = rng() % 24;
+        for (size_t i = 0; i < length; i++) {
+            text += alphabet[rng() % alphabet.size()];
+        }
+
+        std::vector<std::string> expected = splitReference(text);
+        std::vector<std::string> actual = splitScanner(text);
+        if (actual != expected) {
+            std::cerr << "Mismatch on case " << n << ": [" << text << "]" << std::endl;
+            printPieces("std::regex", expected);
+            printPieces("PreTokenizer", actual);
+            return 1;
+        }
+    }
+
+    std::cout << cases << " cases match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Compiles tokenizer.json into the binary format read by BPETokenizer::loadCompiled,
+// then loads the result back and checks that it behaves like the JSON tokenizer.
+//
+// Usage: compile_tokenizer <tokenizer.json> <tokenizer.bin> [sample.txt]
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "bpe_tokenizer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Compare every token and the encoding of each sample; prints the first difference
+bool sameBehavior(const BPETokenizer& expected, const BPETokenizer& actual,
+                  const std::vector<std::string>& samples) {
+    if (expected.vocabSize() != actual.vocabSize() ||
+        expected.mergeCount() != actual.mergeCount() ||
+        expected.addedTokenCount() != actual.addedTokenCount()) {
+        std::cerr << "Table sizes differ" << std::endl;
+        return false;
+    }
+
+    int64_t maxId = static_cast<int64_t>(expected.vocabSize()) + 1024;
+    for (int64_t id = 0; id < maxId; id++) {
+        if (expected.decode({id}, false) != actual.decode({id}, false)) {
+            std::cerr << "Token " << id << " decodes differently" << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto& sample : samples) {
+        if (expected.encode(sample) != actual.encode(sample)) {
+            std::cerr << "Encoding differs for: " << sample << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <tokenizer.json> <tokenizer.bin> [sample.txt]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> samples = {
+        "Hello, welcome to my world!",
+        "It's 3:45pm and we've got 1,234 items [chuckle] in stock.",
+        "  leading and trailing spaces  \n\ttabs\r\nand newlines",
+        "Ünïcödé wörds, 東京, Привет, ١٢٣ and emoji 😀",
+        "snake_case_identifiers and [laugh][sigh] back to back",
+    };
+    if (argc > 3) {
+        std::ifstream sampleFile(argv[3]);
+        std::string line;
+        while (std::getline(sampleFile, line)) {
+            samples.push_back(line);
+        }
+    }
+
+    auto jsonStart = Clock::now();
+    BPETokenizer fromJson;
+    if (!fromJson.loadFromFile(argv[1])) {
+        return 1;
+    }
+    double jsonMs = elapsedMs(jsonStart);
+
+    if (!fromJson.saveCompiled(argv[2])) {
+        return 1;
+    }
+
+    auto compiledStart = Clock::now();
+    BPETokenizer compiled;
+    if (!compiled.loadCompiled(argv[2])) {
+        return 1;
+    }
+    double compiledMs = elapsedMs(compiledStart);
+
+    if (!sameBehavior(fromJson, compiled, samples)) {
+        std::cerr << "Round trip check failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << argv[2] << std::endl;
+    std::cout << "Load time: JSON " << jsonMs << " ms, compiled " << compiledMs << " ms" << std::endl;
+    std::cout << "Round trip check passed (" << samples.size() << " samples)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Generate src/unicode_categories.cpp from Python's Unicode database.
+
+Usage: python3 tools/gen_unicode_tables.py > src/unicode_categories.cpp
+"""
+import sys
+import unicodedata
+
+LETTER = {"Lu", "Ll", "Lt", "Lm", "Lo"}
+NUMBER = {"Nd", "Nl", "No"}
+
+
+def ranges(categories):
+    result = []
+    start = None
+    for cp in range(0x110000):
+        inside = unicodedata.category(chr(cp)) in categories
+        if inside and start is None:
+            start = cp
+        elif not inside and start is not None:
+            result.append((start, cp - 1))
+            start = None
+    if start is not None:
+        result.append((start, 0x10FFFF))
+    return result
+
+
+def table(name, entries):
+    lines = ["const CodepointRange %s[] = {" % name]
+    row = []
+    for first, last in entries:
+        row.append("{0x%04X, 0x%04X}," % (first, last))
+        if len(row) == 4:
+            lines.append("    " + " ".join(row))
+            row = []
+    if row:
+        lines.append("    " + " ".join(row))
+    lines.append("};")
+    return "\n".join(lines)
+
+
+def main():
+    out = sys.stdout
+    out.write("// Generated by tools/gen_unicode_tables.py from Unicode %s, do not edit.\n"
+              % unicodedata.unidata_version)
+    out.write("""#include "unicode_categories.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+struct CodepointRange {
+    char32_t first;
+    char32_t last;
+};
+
+// General categories Lu, Ll, Lt, Lm, Lo
+""")
+    out.write(table("LETTER_RANGES", ranges(LETTER)))
+    out.write("\n\n// General categories Nd, Nl, No\n")
+    out.write(table("NUMBER_RANGES", ranges(NUMBER)))
+    out.write("""
+
+template <size_t N>
+bool inRanges(const CodepointRange (&table)[N], char32_t cp) {
+    const CodepointRange* it = std::upper_bound(
+        std::begin(table), std::end(table), cp,
+        [](char32_t value, const CodepointRange& range) { return value < range.first; });
+    return it != std::begin(table) && cp <= (it - 1)->last;
+}
+
+} // namespace
+
+namespace unicode {
+
+bool isLetter(char32_t cp) {
+    if (cp < 0x80) {
+        return (cp | 0x20) >= 'a' && (cp | 0x20) <= 'z';
+    }
+    return inRanges(LETTER_RANGES, cp);
+}
+
+bool isNumber(char32_t cp) {
+    if (cp < 0x80) {
+        return cp >= '0' && cp <= '9';
+    }
+    return inRanges(NUMBER_RANGES, cp);
+}
+
+bool isWhitespace(char32_t cp) {
+    switch (cp) {
+    case 0x09: case 0x0A: case 0x0B: case 0x0C: case 0x0D: case 0x20:
+    case 0x85: case 0xA0: case 0x1680: case 0x2028: case 0x2029:
+    case 0x202F: case 0x205F: case 0x3000:
+        return true;
+    default:
+        return cp >= 0x2000 && cp <= 0x200A;
+    }
+}
+
+} // namespace unicode
+""")
+
+
+if __name__ == "__main__":
+    main()